@@ -28,20 +28,29 @@
    not, see <http://www.gnu.org/licenses/>.  */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <cerrno>
+#include <condition_variable>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <getopt.h>
 #include <iomanip>
 #include <iostream>
 #include <libintl.h>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
+#include "encoder.hh"
 #include "libzwerg.hh"
 #include "libzwerg-dw.h"
 #include "options.hh"
@@ -103,15 +112,93 @@ show_help (std::vector <ext_option> const &ext_opts)
     }
 }
 
-class dumper
+// A stream buffer that writes to a file descriptor.  Unlike
+// std::cout, it has a buffer large enough that writing many short
+// lines doesn't turn into many write calls.  The buffer is only
+// flushed when it fills up, on explicit flush, and on destruction.
+class fd_streambuf
+  : public std::streambuf
 {
-  zw_vocabulary const &m_voc;
+  int m_fd;
+  std::vector <char> m_buf;
+
+  bool
+  write_all (char const *buf, size_t len)
+  {
+    while (len > 0)
+      {
+	ssize_t n = write (m_fd, buf, len);
+	if (n < 0)
+	  {
+	    if (errno == EINTR)
+	      continue;
+	    return false;
+	  }
+	buf += n;
+	len -= n;
+      }
+    return true;
+  }
+
+protected:
+  int
+  sync () override
+  {
+    size_t len = pptr () - pbase ();
+    setp (m_buf.data (), m_buf.data () + m_buf.size ());
+    return write_all (m_buf.data (), len) ? 0 : -1;
+  }
+
+  int_type
+  overflow (int_type c) override
+  {
+    if (sync () != 0)
+      return traits_type::eof ();
+    if (! traits_type::eq_int_type (c, traits_type::eof ()))
+      {
+	*pptr () = traits_type::to_char_type (c);
+	pbump (1);
+      }
+    return traits_type::not_eof (c);
+  }
+
+  std::streamsize
+  xsputn (char const *s, std::streamsize n) override
+  {
+    if (n > epptr () - pptr ())
+      {
+	if (sync () != 0)
+	  return 0;
+
+	// Don't bother copying chunks that wouldn't fit anyway.
+	if (n >= std::streamsize (m_buf.size ()))
+	  return write_all (s, n) ? n : 0;
+      }
+
+    std::memcpy (pptr (), s, n);
+    pbump (n);
+    return n;
+  }
 
 public:
-  explicit dumper (zw_vocabulary const &voc)
-    : m_voc (voc)
-  {}
+  explicit fd_streambuf (int fd, size_t size = 64 * 1024)
+    : m_fd {fd}
+    , m_buf (size)
+  {
+    setp (m_buf.data (), m_buf.data () + m_buf.size ());
+  }
+
+  ~fd_streambuf ()
+  {
+    sync ();
+  }
+};
 
+class dumper
+{
+  constant_names m_names;
+
+public:
   enum class format
     {
       full,
@@ -141,6 +228,33 @@ private:
 void
 dumper::dump_const (std::ostream &os, zw_value const &val, format fmt)
 {
+  // Decimal and hexadecimal constants are by far the most common, so
+  // format these directly, instead of having libzwerg create a string
+  // value for each.
+  zw_cdom const *dom = zw_value_const_dom (&val);
+  if (dom == zw_cdom_dec () || dom == zw_cdom_hex ())
+    {
+      ios_flag_saver ifs {os};
+      if (dom == zw_cdom_hex ())
+	{
+	  os << std::hex;
+	  if (fmt == format::full)
+	    os << std::showbase;
+	}
+
+      if (! zw_value_const_is_signed (&val))
+	os << zw_value_const_u64 (&val);
+      else
+	{
+	  int64_t i = zw_value_const_i64 (&val);
+	  if (i < 0)
+	    os << '-' << -uint64_t (i);
+	  else
+	    os << uint64_t (i);
+	}
+      return;
+    }
+
   std::unique_ptr <zw_value, zw_deleter> str
        {fmt == format::full ? zw_value_const_format (&val, zw_throw_on_error {})
 	: zw_value_const_format_brief (&val, zw_throw_on_error {})};
@@ -257,73 +371,53 @@ void
 dumper::dump_die (std::ostream &os, zw_value const &val, format fmt)
 {
   Dwarf_Die die = zw_value_die_die (&val);
-  std::unique_ptr <zw_value, zw_deleter> tag
-	{zw_value_init_const_u64 (dwarf_tag (&die), zw_cdom_dw_tag (), 0,
-				  zw_throw_on_error {})};
-
-  std::string tag_name = [&] ()
-    {
-      std::unique_ptr <zw_value, zw_deleter> tmp
-	{zw_value_const_format_brief (tag.get (), zw_throw_on_error {})};
-
-      size_t sz;
-      auto buf = zw_value_str_str (tmp.get (), &sz);
-      return std::string {buf, sz};
-    } ();
 
   {
     ios_flag_saver ifs {os};
     os << '[' << std::hex << dwarf_dieoffset (&die) << ']'
-       << (fmt == format::full ? '\t' : ' ') << tag_name;
+       << (fmt == format::full ? '\t' : ' ')
+       << m_names.get (dwarf_tag (&die), *zw_cdom_dw_tag ());
   }
 
   if (fmt == format::full)
     {
-      static std::unique_ptr <zw_query, zw_deleter> query
-	{zw_query_parse (&m_voc, "raw attribute", zw_throw_on_error {})};
-      exec_query_on (val, *query,
-		     [&] (zw_stack const &stk) -> void {
-		       assert (zw_stack_depth (&stk) == 1);
-		       dump_attr (os << "\n\t", *zw_stack_at (&stk, 0),
-				  format::brief);
-		     });
+      std::unique_ptr <zw_values, zw_deleter> attrs
+	{zw_value_die_attributes_raw (&val, zw_throw_on_error {})};
+      while (auto attr = zw_values_next (*attrs))
+	dump_attr (os << "\n\t", *attr, format::brief);
     }
 }
 
 void
 dumper::dump_attr (std::ostream &os, zw_value const &val, format fmt)
 {
-  static std::unique_ptr <zw_query, zw_deleter> query
-	{zw_query_parse (&m_voc, "[value] swap label", zw_throw_on_error {})};
-  exec_query_on (val, *query,
-		 [&] (zw_stack const &stk) -> void
-		 {
-		   assert (zw_stack_depth (&stk) == 2);
-		   dump_value (os, *zw_stack_at (&stk, 0), format::brief);
-
-		   zw_value const *values = zw_stack_at (&stk, 1);
-		   assert (zw_value_is_seq (values));
-
-		   switch (size_t n = zw_value_seq_length (values))
-		     {
-		     case 0:
-		       os << "\t<no value>";
-		       break;
-		     case 1:
-		       dump_value (os << "\t",
-				   *zw_value_seq_at (values, 0),
-				   format::brief);
-		       break;
-		     default:
-		       for (size_t i = 0; i < n; ++i)
-			 {
-			   os << (fmt == format::brief ? "\n\t\t" : "\n\t");
-			   dump_value (os, *zw_value_seq_at (values, i),
-				       format::brief);
-			 }
-		       break;
-		     }
-		 });
+  Dwarf_Attribute at = zw_value_attr_attr (&val);
+  os << m_names.get (dwarf_whatattr (&at), *zw_cdom_dw_attr ());
+
+  std::vector <std::unique_ptr <zw_value, zw_deleter>> values;
+  {
+    std::unique_ptr <zw_values, zw_deleter> vals
+	{zw_value_attr_values (&val, zw_throw_on_error {})};
+    while (auto v = zw_values_next (*vals))
+      values.push_back (std::move (v));
+  }
+
+  switch (values.size ())
+    {
+    case 0:
+      os << "\t<no value>";
+      break;
+    case 1:
+      dump_value (os << "\t", *values[0], format::brief);
+      break;
+    default:
+      for (auto const &v: values)
+	{
+	  os << (fmt == format::brief ? "\n\t\t" : "\n\t");
+	  dump_value (os, *v, format::brief);
+	}
+      break;
+    }
 }
 
 void
@@ -336,62 +430,34 @@ dumper::dump_llelem (std::ostream &os, zw_value const &val, format fmt)
        << zw_value_llelem_high (&val) << ":";
   }
 
-  static std::unique_ptr <zw_query, zw_deleter> query
-	{zw_query_parse (&m_voc, "[elem]",
-			 zw_throw_on_error {})};
-  exec_query_on (val, *query,
-		 [&] (zw_stack const &stk) -> void
-		 {
-		   assert (zw_stack_depth (&stk) == 2);
-		   zw_value const *ops = zw_stack_at (&stk, 0);
-		   assert (zw_value_is_seq (ops));
-
-		   if (size_t n = zw_value_seq_length (ops))
-		     for (size_t i = 0; i < n; ++i)
-		       {
-			 if (i > 0)
-			   os << ", ";
-
-			 dump_value (os, *zw_value_seq_at (ops, i),
-				     format::brief);
-		       }
-		   else
-		     os << "<empty location expression>";
-		 });
+  std::unique_ptr <zw_values, zw_deleter> ops
+	{zw_value_llelem_ops (&val, zw_throw_on_error {})};
+  bool seen = false;
+  while (auto op = zw_values_next (*ops))
+    {
+      if (seen)
+	os << ", ";
+      dump_value (os, *op, format::brief);
+      seen = true;
+    }
+  if (! seen)
+    os << "<empty location expression>";
 }
 
 void
 dumper::dump_llop (std::ostream &os, zw_value const &val, format fmt)
 {
-  // We could get offset and label through zw_value_llop_op, but to
-  // get values reliably and without duplication, we'd need to go
-  // through Zwerg query "value" anyway.  So just do it all it one go.
-  static std::unique_ptr <zw_query, zw_deleter> query
-	{zw_query_parse (&m_voc, "[offset, label, value]",
-			 zw_throw_on_error {})};
-
-  exec_query_on (val, *query,
-		 [&] (zw_stack const &stk) -> void
-		 {
-		   assert (zw_stack_depth (&stk) == 2);
-		   zw_value const *properties = zw_stack_at (&stk, 0);
-		   assert (zw_value_is_seq (properties));
-
-		   zw_value const *off = zw_value_seq_at (properties, 0);
-		   dump_value (os, *off, format::brief);
-		   os << ' ';
-
-		   zw_value const *lbl = zw_value_seq_at (properties, 1);
-		   dump_value (os, *lbl, format::brief);
-
-		   size_t nppts = zw_value_seq_length (properties);
-		   for (size_t j = 2; j < nppts; ++j)
-		     {
-		       os << ' ';
-		       dump_value (os, *zw_value_seq_at (properties, j),
-				   format::inner_brief);
-		     }
-		 });
+  Dwarf_Op const *op = zw_value_llop_op (&val);
+  {
+    ios_flag_saver ifs {os};
+    os << std::hex << std::showbase << op->offset << ' ';
+  }
+  os << m_names.get (op->atom, *zw_cdom_dw_locexpr_opcode ());
+
+  std::unique_ptr <zw_values, zw_deleter> values
+	{zw_value_llop_values (&val, zw_throw_on_error {})};
+  while (auto v = zw_values_next (*values))
+    dump_value (os << ' ', *v, format::inner_brief);
 }
 
 void
@@ -414,12 +480,7 @@ dumper::dump_aset (std::ostream &os, zw_value const &val, format fmt)
 void
 dumper::dump_named_constant (std::ostream &os, unsigned v, zw_cdom const &dom)
 {
-  std::unique_ptr <zw_value, zw_deleter> cst
-	{zw_value_init_const_u64 (v, &dom, 0, zw_throw_on_error {})};
-  std::unique_ptr <zw_value, zw_deleter> str
-	{zw_value_const_format_brief (cst.get (), zw_throw_on_error {})};
-
-  dump_string (os, *str, format::full);
+  os << m_names.get (v, dom);
 }
 
 void
@@ -504,15 +565,121 @@ namespace
     return ret;
   }
 
-  std::ostream &
-  error_message (bool no_messages, int verbosity, bool &errors)
+  // One element per value yielded by an argument expression.
+  typedef std::vector <std::unique_ptr <zw_value, zw_deleter>> arg_val_vec_t;
+
+  // Advance ARG_ITS to the next combination of argument values.  The
+  // last argument changes fastest, arguments before FIRST are left
+  // alone.  Returns false after all combinations were visited.
+  bool
+  bump_args (std::vector <arg_val_vec_t> const &args,
+	     std::vector <arg_val_vec_t::const_iterator> &arg_its,
+	     size_t first)
   {
-    if (verbosity >= 0)
-      errors = true;
-    return error_message (no_messages);
+    for (size_t ri = 0; ri < args.size () - first; ++ri)
+      {
+	size_t i = args.size () - 1 - ri;
+	if (++arg_its[i] == args[i].end ())
+	  arg_its[i] = args[i].begin ();
+	else
+	  return true;
+      }
+    return false;
   }
 
-  std::vector <std::unique_ptr <zw_value, zw_deleter>>
+  // Run COUNT tasks on JOBS worker threads.  TASK (I) is called in
+  // one of the workers.  EMIT (I) is then called in the calling
+  // thread, in order of I, after TASK (I) has finished.  That way the
+  // output can be shown in the same order as if the tasks were run
+  // one after another.  When a task returns false, no further tasks
+  // are started, and false is returned after emitting that task.
+  // Exceptions escaping a task are rethrown in place of its EMIT.
+  bool
+  run_ordered (size_t count, unsigned jobs,
+	       std::function <bool (size_t)> const &task,
+	       std::function <void (size_t)> const &emit)
+  {
+    struct slot
+    {
+      std::exception_ptr exc;
+      bool cont = true;
+      bool done = false;
+    };
+
+    std::vector <slot> slots (count);
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::atomic <size_t> next_task {0};
+    std::atomic <bool> stop {false};
+
+    auto worker = [&] ()
+      {
+	size_t i;
+	while (! stop && (i = next_task++) < count)
+	  {
+	    bool cont = false;
+	    std::exception_ptr exc;
+	    try
+	      {
+		cont = task (i);
+	      }
+	    catch (...)
+	      {
+		exc = std::current_exception ();
+	      }
+
+	    std::lock_guard <std::mutex> lock {mtx};
+	    slots[i].cont = cont;
+	    slots[i].exc = exc;
+	    slots[i].done = true;
+	    if (! cont)
+	      stop = true;
+	    cv.notify_all ();
+	  }
+      };
+
+    std::vector <std::thread> threads;
+    for (size_t j = 0; j < std::min (size_t (jobs), count); ++j)
+      threads.emplace_back (worker);
+
+    // Tasks are claimed in order, so all tasks preceding the one
+    // that stopped the run have been claimed and will complete.
+    bool ret = true;
+    std::exception_ptr exc;
+    for (size_t i = 0; i < count; ++i)
+      {
+	slot &s = slots[i];
+	{
+	  std::unique_lock <std::mutex> lock {mtx};
+	  cv.wait (lock, [&] () { return s.done; });
+	}
+
+	if (s.exc != nullptr)
+	  {
+	    exc = s.exc;
+	    break;
+	  }
+
+	emit (i);
+
+	if (! s.cont)
+	  {
+	    ret = false;
+	    break;
+	  }
+      }
+
+    stop = true;
+    for (auto &thread: threads)
+      thread.join ();
+
+    if (exc != nullptr)
+      std::rethrow_exception (exc);
+
+    return ret;
+  }
+
+  arg_val_vec_t
   parse_arg_literal (std::string arg)
   {
     std::unique_ptr <zw_value, zw_deleter> value
@@ -523,7 +690,7 @@ namespace
     return ret;
   }
 
-  std::vector <std::unique_ptr <zw_value, zw_deleter>>
+  arg_val_vec_t
   parse_arg_eval (zw_vocabulary const &voc, std::string arg)
   {
     std::vector <std::unique_ptr <zw_value, zw_deleter>> ret;
@@ -598,6 +765,16 @@ try
     bool show_count = false;
     bool with_header = false;
     bool no_header = false;
+    unsigned jobs = 1;
+
+    // Where to read batch arguments from, or null if not in batch mode.
+    char const *batch_fn = nullptr;
+
+    bool show_profile = false;
+    bool show_explain = false;
+
+    // Null for the textual output.
+    std::unique_ptr <encoder> (*make_encoder) () = nullptr;
 
     std::unique_ptr <zw_vocabulary, zw_deleter> voc
 	{zw_vocabulary_init (zw_throw_on_error {})};
@@ -610,9 +787,7 @@ try
     bool query_specified = false;
     std::string query_str;
 
-    // Outer vector has one element per argument.
-    // Inner vector has one element per value yielded by that argument expr.
-    typedef std::vector <std::unique_ptr <zw_value, zw_deleter>> arg_val_vec_t;
+    // One element per argument.
     std::vector <arg_val_vec_t> args;
 
     while (true)
@@ -674,6 +849,23 @@ try
 	      break;
 	    }
 
+	  case 'j':
+	    {
+	      char *end;
+	      errno = 0;
+	      unsigned long n = strtoul (optarg, &end, 10);
+	      if (*optarg == '\0' || *end != '\0' || errno != 0
+		  || n > std::numeric_limits <unsigned>::max ())
+		{
+		  std::cerr << "Error: invalid number of jobs `"
+			    << optarg << "'.\n";
+		  return 2;
+		}
+	      jobs = n != 0 ? n : std::max (std::thread::hardware_concurrency (),
+					    1u);
+	      break;
+	    }
+
           case 'a':
 	    args.push_back (parse_arg_literal (optarg));
 	    break;
@@ -696,6 +888,37 @@ try
                 args.push_back (parse_arg_eval (*voc, optarg));
 		break;
               }
+	    else if (c == batch)
+	      {
+		batch_fn = optarg;
+		break;
+	      }
+	    else if (c == profile)
+	      {
+		show_profile = true;
+		break;
+	      }
+	    else if (c == explain)
+	      {
+		show_explain = true;
+		break;
+	      }
+	    else if (c == output_format)
+	      {
+		if (strcmp (optarg, "text") == 0)
+		  make_encoder = nullptr;
+		else if (strcmp (optarg, "jsonl") == 0)
+		  make_encoder = make_jsonl_encoder;
+		else if (strcmp (optarg, "binary") == 0)
+		  make_encoder = make_binary_encoder;
+		else
+		  {
+		    std::cerr << "Error: unknown output format `"
+			      << optarg << "'.\n";
+		    return 2;
+		  }
+		break;
+	      }
 
 	    return 2;
 	  }
@@ -707,20 +930,50 @@ try
     std::unique_ptr <zw_query, zw_deleter> query {
 	[&] ()
 	  {
-	    if (query_specified)
-	      return zw_query_parse_len (voc.get (), query_str.c_str (),
-					 query_str.length (),
-					 zw_throw_on_error {});
-	    else
+	    if (! query_specified)
 	      {
 		if (argc == 0)
 		  throw std::runtime_error ("No query specified.");
 
 		argc--;
-		return zw_query_parse (&*voc, *argv++, zw_throw_on_error {});
+		query_str = *argv++;
 	      }
+
+	    if (show_profile)
+	      return zw_query_parse_profiled (voc.get (), query_str.c_str (),
+					      query_str.length (),
+					      zw_throw_on_error {});
+	    else
+	      return zw_query_parse_len (voc.get (), query_str.c_str (),
+					 query_str.length (),
+					 zw_throw_on_error {});
 	  } ()};
 
+    // Under --profile, the statistics are shown however dwgrep exits
+    // from here on.
+    struct profile_printer
+    {
+      zw_query const *m_query;
+
+      ~profile_printer ()
+      {
+	if (m_query == nullptr)
+	  return;
+	try
+	  {
+	    std::unique_ptr <zw_value, zw_deleter> str
+		{zw_query_profile (m_query, zw_throw_on_error {})};
+	    size_t len;
+	    char const *buf = zw_value_str_str (str.get (), &len);
+	    std::cerr.write (buf, len);
+	  }
+	catch (std::runtime_error const &e)
+	  {
+	    std::cerr << "dwgrep: " << e.what () << std::endl;
+	  }
+      }
+    } prof_printer {show_profile ? query.get () : nullptr};
+
     std::vector <std::string> file_args;
     if (argc > 0)
       {
@@ -740,22 +993,47 @@ try
 	args.emplace (args.begin (), std::move (dwvs));
       }
 
+    if (show_explain)
+      {
+	// Explain the query as it is built for the first combination
+	// of arguments.
+	std::unique_ptr <zw_stack, zw_deleter> stack
+	    {zw_stack_init (zw_throw_on_error {})};
+	for (auto const &arg: args)
+	  if (! arg.empty ())
+	    zw_stack_push (stack.get (), arg.front ().get (),
+			   zw_throw_on_error {});
+
+	std::unique_ptr <zw_value, zw_deleter> str
+	    {zw_query_explain (voc.get (), query_str.c_str (),
+			       query_str.length (), stack.get (),
+			       zw_throw_on_error {})};
+	size_t len;
+	char const *buf = zw_value_str_str (str.get (), &len);
+	std::cout.write (buf, len);
+	return 0;
+      }
+
     size_t iterations = 1;
     for (auto const &arg: args)
       iterations *= arg.size ();
 
-    if (iterations > 1)
+    if (iterations > 1 || batch_fn != nullptr)
       with_header = true;
     if (no_header)
       with_header = false;
 
-    std::vector <arg_val_vec_t::const_iterator> arg_its;
-    for (auto const &arg: args)
-      arg_its.push_back (arg.begin ());
+    std::atomic <bool> errors {false};
+    std::atomic <bool> match {false};
 
-    bool errors = false;
-    bool match = false;
-    while (true)
+    // Results are written through a large buffer.  When a user
+    // watches them come, each result is flushed as it's made.
+    fd_streambuf out_buf {STDOUT_FILENO};
+    std::ostream out {&out_buf};
+    bool const interactive = isatty (STDOUT_FILENO);
+
+    auto args_stack = [&] (std::vector <arg_val_vec_t::const_iterator>
+				const &arg_its)
       {
 	std::unique_ptr <zw_stack, zw_deleter> stack
 	    {zw_stack_init (zw_throw_on_error {})};
@@ -770,101 +1048,375 @@ try
 				zw_throw_on_error {});
 	  }
 
-	dumper dump {*voc};
+	return stack;
+      };
 
-	std::string header = [&] ()
+    auto args_header = [&] (std::vector <arg_val_vec_t::const_iterator>
+				const &arg_its)
+      {
+	dumper dump;
+	std::stringstream ss;
+	bool seen = false;
+	for (size_t i = 0; i < args.size (); ++i)
 	  {
-	    std::stringstream ss;
-	    bool seen = false;
-	    for (size_t i = 0; i < args.size (); ++i)
-	      {
-		zw_value const &cur = *arg_its[i]->get ();
+	    zw_value const &cur = *arg_its[i]->get ();
 
-		// Always show the first argument if it refers to a file name
-		// given on the command line.
-		if ((i == 0 && file_args.size () > 0) || args[i].size () > 1)
-		  {
-		    if (seen)
-		      ss << ',';
-		    dump.dump_value (ss, cur, dumper::format::header);
-		    seen = true;
-		  }
+	    // Always show the first argument if it refers to a file name
+	    // given on the command line, and the argument read in batch
+	    // mode.
+	    if ((i == 0 && file_args.size () > 0) || args[i].size () > 1
+		|| (batch_fn != nullptr && i + 1 == args.size ()))
+	      {
+		if (seen)
+		  ss << ',';
+		dump.dump_value (ss, cur, dumper::format::header);
+		seen = true;
 	      }
-	    if (! seen)
-	      ss << "<no-file>";
-	    return ss.str ();
-	  } ();
+	  }
+	if (! seen)
+	  ss << "<no-file>";
+	return ss.str ();
+      };
+
+    struct run_stats
+    {
+      uint64_t count = 0;
+      bool failed = false;
+    };
+
+    // Run the query on STACK.  Normal output goes to OS, error
+    // messages to ES.  Under -c, matches are only counted in STATS.
+    // Returns false if dwgrep should exit right away.
+    auto run_one = [&] (zw_stack const &stack, std::string const &header,
+			std::ostream &os, std::ostream &es,
+			run_stats &stats) -> bool
+      {
+	dumper dump;
+	auto enc = make_encoder != nullptr ? make_encoder () : nullptr;
 
 	try
 	  {
 	    std::unique_ptr <zw_result, zw_deleter> result
-		{zw_query_execute (query.get (), stack.get (),
+		{zw_query_execute (query.get (), &stack,
 				   zw_throw_on_error {})};
 
-	    uint64_t count = 0;
 	    while (auto out = zw_result_next (*result))
 	      {
 		// grep: Exit immediately with zero status if any match
 		// is found, even if an error was detected.
 		if (verbosity < 0)
-		  return 0;
+		  return false;
 
 		zw_stack &stk = *out.get ();
 		match = true;
 		if (! show_count)
 		  {
-		    if (with_header)
-		      std::cout << header << ":\n";
-		    if (zw_stack_depth (&stk) > 1)
-		      std::cout << "---\n";
-		    for (size_t i = 0, n = zw_stack_depth (&stk);
-			 i < n; ++i)
+		    if (enc != nullptr)
+		      enc->encode (os, stk, with_header ? &header : nullptr);
+		    else
 		      {
-			auto const *val = zw_stack_at (&stk, i);
-			assert (val != nullptr);
-			dump.dump_value (std::cout, *val,
-					 dumper::format::full);
-			std::cout << std::endl;
+			if (with_header)
+			  os << header << ":\n";
+			if (zw_stack_depth (&stk) > 1)
+			  os << "---\n";
+			for (size_t i = 0, n = zw_stack_depth (&stk);
+			     i < n; ++i)
+			  {
+			    auto const *val = zw_stack_at (&stk, i);
+			    assert (val != nullptr);
+			    dump.dump_value (os, *val, dumper::format::full);
+			    os << '\n';
+			  }
 		      }
+		    if (interactive)
+		      os.flush ();
 		  }
 		else
-		  ++count;
-	      }
-
-	    if (show_count)
-	      {
-		if (with_header)
-		  std::cout << header << ":";
-		std::cout << std::dec << count << std::endl;
+		  ++stats.count;
 	      }
 	  }
 	catch (std::runtime_error const &e)
 	  {
-	    error_message (no_messages, verbosity, errors)
-	      << "dwgrep: " << header << ": " << e.what () << std::endl;
+	    if (verbosity >= 0)
+	      errors = true;
+	    stats.failed = true;
+	    os.flush ();
+	    es << "dwgrep: " << header << ": " << e.what () << std::endl;
 	  }
 	catch (...)
 	  {
-	    error_message (no_messages, verbosity, errors)
-	      << "dwgrep: " << header << ": Unknown error" << std::endl;
+	    if (verbosity >= 0)
+	      errors = true;
+	    stats.failed = true;
+	    os.flush ();
+	    es << "dwgrep: " << header << ": Unknown error" << std::endl;
+	  }
+
+	return true;
+      };
+
+    auto show_stats = [&] (std::ostream &os, std::string const &header,
+			   run_stats const &stats)
+      {
+	if (show_count && ! stats.failed)
+	  {
+	    if (with_header)
+	      os << header << ":";
+	    os << std::dec << stats.count << '\n';
+	    if (interactive)
+	      os.flush ();
+	  }
+      };
+
+    // Run the query on all combinations of arguments that have the
+    // first argument at FIRST_ARG.
+    auto run_first_arg = [&] (size_t first_arg,
+			      std::ostream &os, std::ostream &es)
+      {
+	std::vector <arg_val_vec_t::const_iterator> arg_its;
+	for (auto const &arg: args)
+	  arg_its.push_back (arg.begin ());
+	arg_its.front () += first_arg;
+
+	do
+	  {
+	    auto stack = args_stack (arg_its);
+	    std::string header = args_header (arg_its);
+	    run_stats stats;
+	    if (! run_one (*stack, header, os, es, stats))
+	      return false;
+	    show_stats (os, header, stats);
 	  }
+	while (bump_args (args, arg_its, 1));
 
-	// Bump argument list.
-	bool next = false;
-	for (size_t ri = 0; ri < args.size (); ++ri)
+	return true;
+      };
+
+    // Values of the first argument are distributed among the worker
+    // threads.  libdw handles are not safe to share across threads,
+    // so this is only done when the first argument holds the files
+    // opened above, each with its own Dwfl, and the remaining
+    // arguments are plain values.
+    auto is_plain = [] (arg_val_vec_t const &arg)
+      {
+	return std::all_of (arg.begin (), arg.end (),
+			    [] (std::unique_ptr <zw_value, zw_deleter> const &v)
+			    {
+			      return zw_value_is_const (v.get ())
+				|| zw_value_is_str (v.get ());
+			    });
+      };
+
+    // Run the query on all combinations of arguments.  Returns false
+    // if dwgrep should exit right away.
+    auto run_all_args = [&] ()
+      {
+	std::vector <arg_val_vec_t::const_iterator> arg_its;
+	for (auto const &arg: args)
+	  arg_its.push_back (arg.begin ());
+
+	do
+	  {
+	    auto stack = args_stack (arg_its);
+	    std::string header = args_header (arg_its);
+	    run_stats stats;
+	    if (! run_one (*stack, header, out,
+			   error_message (no_messages), stats))
+	      return false;
+	    show_stats (out, header, stats);
+	  }
+	while (bump_args (args, arg_its, 0));
+
+	return true;
+      };
+
+    if (batch_fn != nullptr)
+      {
+	// Each line is one more argument, and the query is run with
+	// each of them in turn.  Files stay open in between, and so do
+	// caches attached to them.
+	std::ifstream ifs;
+	if (strcmp (batch_fn, "-") != 0)
 	  {
-	    size_t i = args.size () - 1 - ri;
-	    if (++arg_its[i] == args[i].end ())
-	      arg_its[i] = args[i].begin ();
+	    ifs.open (batch_fn);
+	    if (ifs.fail ())
+	      {
+		std::cerr << "Error: can't open batch file `"
+			  << batch_fn << "'.\n";
+		return 2;
+	      }
+	  }
+	std::istream &is = ifs.is_open () ? ifs : std::cin;
+
+	std::string line;
+	while (std::getline (is, line))
+	  {
+	    if (line.find_first_not_of (" \t") == std::string::npos)
+	      continue;
+
+	    arg_val_vec_t vals;
+	    try
+	      {
+		vals = parse_arg_eval (*voc, line);
+	      }
+	    catch (std::runtime_error const &e)
+	      {
+		errors = true;
+		out.flush ();
+		error_message (no_messages)
+		  << "dwgrep: " << e.what () << std::endl;
+		continue;
+	      }
+
+	    if (vals.empty ())
+	      continue;
+
+	    args.push_back (std::move (vals));
+	    bool go_on = run_all_args ();
+	    args.pop_back ();
+	    if (! go_on)
+	      return 0;
+
+	    // Whoever feeds the lines may wait for the answer before
+	    // sending the next one.
+	    out.flush ();
+	  }
+      }
+    else if (jobs > 1 && ! file_args.empty () && ! show_profile
+	&& std::all_of (args.begin () + 1, args.end (), is_plain))
+      {
+	// A task is either a whole file, or, for queries that split by
+	// units, one unit of a file.  In the latter case, workers open
+	// their own copy of the file.
+	size_t const whole_file = -1;
+	struct task
+	{
+	  size_t file;
+	  size_t unit;
+	  std::string header;
+	  std::stringstream os;
+	  std::stringstream es;
+	  run_stats stats;
+
+	  task (size_t a_file, size_t a_unit)
+	    : file {a_file}
+	    , unit {a_unit}
+	  {}
+	};
+
+	std::vector <task> tasks;
+	bool split = args.size () == 1
+	  && zw_query_splits_by_unit (query.get ());
+
+	std::unique_ptr <zw_query, zw_deleter> unit_query
+	    {zw_query_parse (voc.get (), "unit", zw_throw_on_error {})};
+
+	for (size_t i = 0; i < args.front ().size (); ++i)
+	  {
+	    // A file whose units can't be listed is searched whole,
+	    // so that the error is reported where the serial run would.
+	    size_t units = 0;
+	    if (split)
+	      try
+		{
+		  exec_query_on (*args.front ()[i], *unit_query,
+				 [&] (zw_stack const &) { ++units; });
+		}
+	      catch (std::runtime_error const &e)
+		{
+		  units = 0;
+		}
+
+	    if (units == 0)
+	      tasks.emplace_back (i, whole_file);
 	    else
 	      {
-		next = true;
-		break;
+		std::vector <arg_val_vec_t::const_iterator> arg_its
+		  = {args.front ().begin () + i};
+		std::string header = args_header (arg_its);
+		for (size_t j = 0; j < units; ++j)
+		  {
+		    tasks.emplace_back (i, j);
+		    tasks.back ().header = header;
+		  }
 	      }
 	  }
-	if (! next)
-	  break;
+
+	auto run_task = [&] (size_t i)
+	  {
+	    task &t = tasks[i];
+	    if (t.unit == whole_file)
+	      return run_first_arg (t.file, t.os, t.es);
+
+	    // Units of the file that this worker has open.
+	    struct worker_file
+	    {
+	      size_t file = whole_file;
+	      std::unique_ptr <zw_value, zw_deleter> dw;
+	      arg_val_vec_t units;
+	    };
+	    static thread_local worker_file wf;
+
+	    if (wf.file != t.file)
+	      {
+		wf.units.clear ();
+		wf.dw.reset (zw_value_init_dwarf
+				(file_args[t.file].c_str (), t.file,
+				 zw_throw_on_error {}));
+		wf.file = t.file;
+		exec_query_on (*wf.dw, *unit_query,
+			       [&] (zw_stack const &stk)
+			       {
+				 zw_value const &tos = *zw_stack_at (&stk, 0);
+				 wf.units.emplace_back
+				   (zw_value_clone (&tos, zw_value_pos (&tos),
+						    zw_throw_on_error {}));
+			       });
+	      }
+
+	    if (t.unit >= wf.units.size ())
+	      throw std::runtime_error ("file changed during the search");
+
+	    std::unique_ptr <zw_stack, zw_deleter> stack
+		{zw_stack_init (zw_throw_on_error {})};
+	    zw_stack_push (stack.get (), wf.units[t.unit].get (),
+			   zw_throw_on_error {});
+	    return run_one (*stack, t.header, t.os, t.es, t.stats);
+	  };
+
+	// The serial run stops at the first error in a file.  Results
+	// of the units after the failed one are thus dropped, and the
+	// counts of a unit-split file are summed.
+	run_stats file_stats;
+	auto emit_task = [&] (size_t i)
+	  {
+	    task &t = tasks[i];
+	    if (! file_stats.failed)
+	      {
+		out << t.os.str ();
+		std::string es = t.es.str ();
+		if (! es.empty () || interactive)
+		  out.flush ();
+		error_message (no_messages) << es;
+		file_stats.count += t.stats.count;
+		file_stats.failed = t.stats.failed;
+	      }
+	    t.os.str ("");
+	    t.es.str ("");
+
+	    if (i + 1 == tasks.size () || tasks[i + 1].file != t.file)
+	      {
+		if (t.unit != whole_file)
+		  show_stats (out, t.header, file_stats);
+		file_stats = run_stats {};
+	      }
+	  };
+
+	if (! run_ordered (tasks.size (), jobs, run_task, emit_task))
+	  return 0;
       }
+    else if (! run_all_args ())
+      return 0;
 
     if (errors)
 	return 2;
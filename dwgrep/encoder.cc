@@ -0,0 +1,543 @@
+/*
+   Copyright (C) 2026 Petr Machata
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#include <cstring>
+#include <iostream>
+
+#include "encoder.hh"
+#include "libzwerg.hh"
+#include "libzwerg-dw.h"
+#include "libzwerg/flag_saver.hh"
+
+std::string const &
+constant_names::get (uint64_t v, zw_cdom const &dom)
+{
+  auto key = std::make_pair (&dom, v);
+  auto it = m_names.find (key);
+  if (it != m_names.end ())
+    return it->second;
+
+  std::unique_ptr <zw_value, zw_deleter> cst
+	{zw_value_init_const_u64 (v, &dom, 0, zw_throw_on_error {})};
+  std::unique_ptr <zw_value, zw_deleter> str
+	{zw_value_const_format_brief (cst.get (), zw_throw_on_error {})};
+
+  size_t sz;
+  auto buf = zw_value_str_str (str.get (), &sz);
+  return m_names.emplace (key, std::string {buf, sz}).first->second;
+}
+
+namespace
+{
+  Dwarf_Off
+  die_unit_offset (Dwarf_Die &die)
+  {
+    return dwarf_dieoffset (&die) - dwarf_cuoffset (&die);
+  }
+
+  // DIE's from a dwz alternate file may have the same offsets as
+  // those from the main file.  To tell them apart, Dwarf's of each
+  // Dwfl are numbered in the order of its modules, each main Dwarf
+  // followed by its alternate file, if any.
+  class dwarf_ids
+  {
+    std::map <Dwarf *, unsigned> m_ids;
+
+    static int
+    add_module (Dwfl_Module *mod, void **, char const *, Dwarf_Addr,
+		void *arg)
+    {
+      auto &ids = *static_cast <std::map <Dwarf *, unsigned> *> (arg);
+      Dwarf_Addr bias;
+      if (Dwarf *dw = dwfl_module_getdwarf (mod, &bias))
+	{
+	  ids.emplace (dw, ids.size ());
+	  if (Dwarf *alt = dwarf_getalt (dw))
+	    ids.emplace (alt, ids.size ());
+	}
+      return DWARF_CB_OK;
+    }
+
+  public:
+    // Return number of the Dwarf that DIE, which is a DIE value,
+    // comes from.
+    unsigned
+    get (zw_value const &die)
+    {
+      Dwarf_Die d = zw_value_die_die (&die);
+      Dwarf *dw = dwarf_cu_getdwarf (d.cu);
+      auto it = m_ids.find (dw);
+      if (it != m_ids.end ())
+	return it->second;
+
+      // Number all Dwarf's of this Dwfl at once.  The numbers only
+      // need to be distinct within one Dwfl, so each Dwfl starts
+      // from 0.
+      std::map <Dwarf *, unsigned> ids;
+      zw_value const *dwv = zw_value_die_dwarf (&die, zw_throw_on_error {});
+      dwfl_getmodules (zw_value_dwarf_dwfl (dwv), &add_module, &ids, 0);
+      ids.emplace (dw, ids.size ());
+      m_ids.insert (ids.begin (), ids.end ());
+      return ids[dw];
+    }
+  };
+
+  class jsonl_encoder
+    : public encoder
+  {
+    constant_names m_names;
+    dwarf_ids m_dwarf_ids;
+
+    // Return length of a well-formed UTF-8 sequence of more than one
+    // byte at BUF, or 0 if there's none.  LEN is how many bytes are
+    // available.
+    static size_t
+    utf8_length (unsigned char const *buf, size_t len)
+    {
+      size_t n;
+      unsigned char lo = 0x80, hi = 0xbf;
+      if (buf[0] >= 0xc2 && buf[0] <= 0xdf)
+	n = 2;
+      else if (buf[0] >= 0xe0 && buf[0] <= 0xef)
+	{
+	  n = 3;
+	  if (buf[0] == 0xe0)
+	    lo = 0xa0;	// Overlong.
+	  else if (buf[0] == 0xed)
+	    hi = 0x9f;	// Surrogates.
+	}
+      else if (buf[0] >= 0xf0 && buf[0] <= 0xf4)
+	{
+	  n = 4;
+	  if (buf[0] == 0xf0)
+	    lo = 0x90;	// Overlong.
+	  else if (buf[0] == 0xf4)
+	    hi = 0x8f;	// Beyond U+10FFFF.
+	}
+      else
+	return 0;
+
+      if (n > len || buf[1] < lo || buf[1] > hi)
+	return 0;
+      for (size_t i = 2; i < n; ++i)
+	if (buf[i] < 0x80 || buf[i] > 0xbf)
+	  return 0;
+      return n;
+    }
+
+    // JSON strings are UTF-8, but strings in DWARF may be in any
+    // encoding.  Bytes that are not part of well-formed UTF-8 are
+    // written as U+FFFD.
+    static void
+    string (std::ostream &os, char const *buf, size_t len)
+    {
+      os << '"';
+      for (size_t i = 0; i < len; ++i)
+	switch (char c = buf[i])
+	  {
+	  case '"':  os << "\\\""; break;
+	  case '\\': os << "\\\\"; break;
+	  case '\n': os << "\\n"; break;
+	  case '\t': os << "\\t"; break;
+	  default:
+	    if ((unsigned char) c < 0x20)
+	      {
+		static char const digits[] = "0123456789abcdef";
+		os << "\\u00" << digits[(c >> 4) & 0xf] << digits[c & 0xf];
+	      }
+	    else if ((unsigned char) c < 0x80)
+	      os << c;
+	    else if (size_t n = utf8_length
+			((unsigned char const *) buf + i, len - i))
+	      {
+		os.write (buf + i, n);
+		i += n - 1;
+	      }
+	    else
+	      os << "\\ufffd";
+	  }
+      os << '"';
+    }
+
+    static void
+    string (std::ostream &os, std::string const &str)
+    {
+      string (os, str.c_str (), str.length ());
+    }
+
+    static void
+    string (std::ostream &os, char const *str)
+    {
+      string (os, str, strlen (str));
+    }
+
+    void
+    values (std::ostream &os, zw_values *vals)
+    {
+      std::unique_ptr <zw_values, zw_deleter> holder {vals};
+      os << '[';
+      bool seen = false;
+      while (auto v = zw_values_next (*vals))
+	{
+	  if (seen)
+	    os << ", ";
+	  slot (os, *v);
+	  seen = true;
+	}
+      os << ']';
+    }
+
+    void
+    slot (std::ostream &os, zw_value const &val)
+    {
+      if (zw_value_is_const (&val))
+	{
+	  os << "{\"type\": \"const\", \"value\": ";
+	  if (zw_value_const_is_signed (&val))
+	    os << zw_value_const_i64 (&val);
+	  else
+	    os << zw_value_const_u64 (&val);
+
+	  zw_cdom const *dom = zw_value_const_dom (&val);
+	  string (os << ", \"domain\": ", zw_cdom_name (dom));
+	  if (! zw_cdom_is_arith (dom))
+	    string (os << ", \"name\": ",
+		    m_names.get (zw_value_const_is_signed (&val)
+				 ? zw_value_const_i64 (&val)
+				 : zw_value_const_u64 (&val), *dom));
+	  os << '}';
+	}
+      else if (zw_value_is_str (&val))
+	{
+	  size_t len;
+	  char const *buf = zw_value_str_str (&val, &len);
+	  string (os << "{\"type\": \"str\", \"value\": ", buf, len);
+	  os << '}';
+	}
+      else if (zw_value_is_seq (&val))
+	{
+	  os << "{\"type\": \"seq\", \"value\": [";
+	  for (size_t n = zw_value_seq_length (&val), i = 0; i < n; ++i)
+	    {
+	      if (i > 0)
+		os << ", ";
+	      slot (os, *zw_value_seq_at (&val, i));
+	    }
+	  os << "]}";
+	}
+      else if (zw_value_is_dwarf (&val))
+	{
+	  string (os << "{\"type\": \"dwarf\", \"name\": ",
+		  zw_value_dwarf_name (&val));
+	  os << '}';
+	}
+      else if (zw_value_is_cu (&val))
+	os << "{\"type\": \"cu\", \"offset\": " << zw_value_cu_offset (&val)
+	   << '}';
+      else if (zw_value_is_die (&val))
+	{
+	  Dwarf_Die die = zw_value_die_die (&val);
+	  int tag = dwarf_tag (&die);
+	  os << "{\"type\": \"die\", \"offset\": " << dwarf_dieoffset (&die)
+	     << ", \"unit\": " << die_unit_offset (die)
+	     << ", \"dwarf\": " << m_dwarf_ids.get (val)
+	     << ", \"tag\": " << tag;
+	  string (os << ", \"tag_name\": ", m_names.get (tag, *zw_cdom_dw_tag ()));
+	  os << '}';
+	}
+      else if (zw_value_is_attr (&val))
+	{
+	  Dwarf_Attribute at = zw_value_attr_attr (&val);
+	  unsigned name = dwarf_whatattr (&at);
+	  unsigned form = dwarf_whatform (&at);
+	  os << "{\"type\": \"attr\", \"at\": " << name;
+	  string (os << ", \"at_name\": ",
+		  m_names.get (name, *zw_cdom_dw_attr ()));
+	  os << ", \"form\": " << form;
+	  string (os << ", \"form_name\": ",
+		  m_names.get (form, *zw_cdom_dw_form ()));
+	  values (os << ", \"value\": ",
+		  zw_value_attr_values (&val, zw_throw_on_error {}));
+	  os << '}';
+	}
+      else if (zw_value_is_llelem (&val))
+	{
+	  os << "{\"type\": \"llelem\", \"low\": " << zw_value_llelem_low (&val)
+	     << ", \"high\": " << zw_value_llelem_high (&val);
+	  values (os << ", \"value\": ",
+		  zw_value_llelem_ops (&val, zw_throw_on_error {}));
+	  os << '}';
+	}
+      else if (zw_value_is_llop (&val))
+	{
+	  Dwarf_Op const *op = zw_value_llop_op (&val);
+	  os << "{\"type\": \"llop\", \"offset\": " << op->offset
+	     << ", \"op\": " << unsigned (op->atom);
+	  string (os << ", \"op_name\": ",
+		  m_names.get (op->atom, *zw_cdom_dw_locexpr_opcode ()));
+	  values (os << ", \"value\": ",
+		  zw_value_llop_values (&val, zw_throw_on_error {}));
+	  os << '}';
+	}
+      else if (zw_value_is_aset (&val))
+	{
+	  os << "{\"type\": \"aset\", \"value\": [";
+	  for (size_t n = zw_value_aset_length (&val), i = 0; i < n; ++i)
+	    {
+	      zw_aset_pair p = zw_value_aset_at (&val, i);
+	      os << (i > 0 ? ", [" : "[") << p.start << ", " << p.length << ']';
+	    }
+	  os << "]}";
+	}
+      else if (zw_value_is_elfsym (&val))
+	{
+	  GElf_Sym sym = zw_value_elfsym_symbol (&val);
+	  os << "{\"type\": \"elfsym\", \"index\": "
+	     << zw_value_elfsym_symidx (&val);
+	  string (os << ", \"name\": ", zw_value_elfsym_name (&val));
+	  os << ", \"value\": " << sym.st_value
+	     << ", \"size\": " << sym.st_size
+	     << ", \"info\": " << unsigned (sym.st_info)
+	     << ", \"other\": " << unsigned (sym.st_other) << '}';
+	}
+      else
+	os << "{\"type\": \"unknown\"}";
+    }
+
+  public:
+    void
+    encode (std::ostream &os, zw_stack const &stk,
+	    std::string const *header) override
+    {
+      ios_flag_saver ifs {os};
+      os << std::dec << std::noshowbase << '{';
+      if (header != nullptr)
+	string (os << "\"file\": ", *header);
+      os << (header != nullptr ? ", " : "") << "\"stack\": [";
+      for (size_t i = 0, n = zw_stack_depth (&stk); i < n; ++i)
+	{
+	  if (i > 0)
+	    os << ", ";
+	  slot (os, *zw_stack_at (&stk, i));
+	}
+      os << "]}\n";
+    }
+  };
+
+  class binary_encoder
+    : public encoder
+  {
+    // The record being encoded.  It's kept around so that its storage
+    // is reused for all records.
+    std::string m_buf;
+    dwarf_ids m_dwarf_ids;
+
+    void
+    u8 (uint8_t v)
+    {
+      m_buf.push_back (v);
+    }
+
+    void
+    u32 (uint32_t v)
+    {
+      for (int i = 0; i < 4; ++i, v >>= 8)
+	m_buf.push_back (v & 0xff);
+    }
+
+    void
+    u64 (uint64_t v)
+    {
+      for (int i = 0; i < 8; ++i, v >>= 8)
+	m_buf.push_back (v & 0xff);
+    }
+
+    void
+    str (char const *buf, size_t len)
+    {
+      u32 (len);
+      m_buf.append (buf, len);
+    }
+
+    void
+    str (char const *s)
+    {
+      str (s, strlen (s));
+    }
+
+    void
+    values (zw_values *vals)
+    {
+      std::unique_ptr <zw_values, zw_deleter> holder {vals};
+      size_t count_at = m_buf.size ();
+      u32 (0);
+
+      uint32_t count = 0;
+      for (; auto v = zw_values_next (*vals); ++count)
+	slot (*v);
+
+      patch_u32 (count_at, count);
+    }
+
+    void
+    patch_u32 (size_t at, uint32_t v)
+    {
+      for (int i = 0; i < 4; ++i, v >>= 8)
+	m_buf[at + i] = v & 0xff;
+    }
+
+    void
+    slot (zw_value const &val)
+    {
+      if (zw_value_is_const (&val))
+	{
+	  bool is_signed = zw_value_const_is_signed (&val);
+	  u8 (1);
+	  u8 (is_signed);
+	  u64 (is_signed ? zw_value_const_i64 (&val)
+	       : zw_value_const_u64 (&val));
+	  str (zw_cdom_name (zw_value_const_dom (&val)));
+	}
+      else if (zw_value_is_str (&val))
+	{
+	  size_t len;
+	  char const *buf = zw_value_str_str (&val, &len);
+	  u8 (2);
+	  str (buf, len);
+	}
+      else if (zw_value_is_seq (&val))
+	{
+	  size_t n = zw_value_seq_length (&val);
+	  u8 (3);
+	  u32 (n);
+	  for (size_t i = 0; i < n; ++i)
+	    slot (*zw_value_seq_at (&val, i));
+	}
+      else if (zw_value_is_dwarf (&val))
+	{
+	  u8 (4);
+	  str (zw_value_dwarf_name (&val));
+	}
+      else if (zw_value_is_cu (&val))
+	{
+	  u8 (5);
+	  u64 (zw_value_cu_offset (&val));
+	}
+      else if (zw_value_is_die (&val))
+	{
+	  Dwarf_Die die = zw_value_die_die (&val);
+	  u8 (6);
+	  u64 (dwarf_dieoffset (&die));
+	  u64 (die_unit_offset (die));
+	  u32 (dwarf_tag (&die));
+	  u32 (m_dwarf_ids.get (val));
+	}
+      else if (zw_value_is_attr (&val))
+	{
+	  Dwarf_Attribute at = zw_value_attr_attr (&val);
+	  u8 (7);
+	  u32 (dwarf_whatattr (&at));
+	  u32 (dwarf_whatform (&at));
+	  values (zw_value_attr_values (&val, zw_throw_on_error {}));
+	}
+      else if (zw_value_is_llelem (&val))
+	{
+	  u8 (8);
+	  u64 (zw_value_llelem_low (&val));
+	  u64 (zw_value_llelem_high (&val));
+	  values (zw_value_llelem_ops (&val, zw_throw_on_error {}));
+	}
+      else if (zw_value_is_llop (&val))
+	{
+	  Dwarf_Op const *op = zw_value_llop_op (&val);
+	  u8 (9);
+	  u64 (op->offset);
+	  u32 (op->atom);
+	  values (zw_value_llop_values (&val, zw_throw_on_error {}));
+	}
+      else if (zw_value_is_aset (&val))
+	{
+	  size_t n = zw_value_aset_length (&val);
+	  u8 (10);
+	  u32 (n);
+	  for (size_t i = 0; i < n; ++i)
+	    {
+	      zw_aset_pair p = zw_value_aset_at (&val, i);
+	      u64 (p.start);
+	      u64 (p.length);
+	    }
+	}
+      else if (zw_value_is_elfsym (&val))
+	{
+	  GElf_Sym sym = zw_value_elfsym_symbol (&val);
+	  u8 (11);
+	  u32 (zw_value_elfsym_symidx (&val));
+	  u64 (sym.st_value);
+	  u64 (sym.st_size);
+	  u8 (sym.st_info);
+	  u8 (sym.st_other);
+	  str (zw_value_elfsym_name (&val));
+	}
+      else
+	u8 (0);
+    }
+
+  public:
+    void
+    encode (std::ostream &os, zw_stack const &stk,
+	    std::string const *header) override
+    {
+      m_buf.clear ();
+      u32 (0);
+      if (header != nullptr)
+	str (header->c_str (), header->length ());
+      else
+	u32 (0);
+
+      size_t n = zw_stack_depth (&stk);
+      u32 (n);
+      for (size_t i = 0; i < n; ++i)
+	slot (*zw_stack_at (&stk, i));
+
+      patch_u32 (0, m_buf.size () - 4);
+      os.write (m_buf.data (), m_buf.size ());
+    }
+  };
+}
+
+std::unique_ptr <encoder>
+make_jsonl_encoder ()
+{
+  return std::make_unique <jsonl_encoder> ();
+}
+
+std::unique_ptr <encoder>
+make_binary_encoder ()
+{
+  return std::make_unique <binary_encoder> ();
+}
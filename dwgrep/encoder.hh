@@ -0,0 +1,111 @@
+/*
+   Copyright (C) 2026 Petr Machata
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _ENCODER_H_
+#define _ENCODER_H_
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "libzwerg.h"
+
+// Cache of brief names of named constants, such as DW_TAG_*, indexed
+// by domain and value.
+class constant_names
+{
+  std::map <std::pair <zw_cdom const *, uint64_t>, std::string> m_names;
+
+public:
+  std::string const &get (uint64_t v, zw_cdom const &dom);
+};
+
+// Machine-readable formats of query results.  Unlike the textual
+// output, these retain types of values and their raw properties
+// (offsets, codes, etc.), so that they don't need to be parsed back.
+//
+// Values of attributes, location expressions and location operations
+// are enumerated through libzwerg, which allocates a producer and the
+// values for each such slot.  Other slots only allocate when names
+// of constants, or numbers of Dwarf's, are first looked up.
+class encoder
+{
+public:
+  virtual ~encoder () {}
+
+  // Write one query result STK to OS.  If HEADER is not null, it
+  // names the input that STK was produced from.
+  virtual void encode (std::ostream &os, zw_stack const &stk,
+		       std::string const *header) = 0;
+};
+
+// One JSON object per line:
+//
+//   {"file": HEADER, "stack": [SLOT, ...]}
+//
+// "file" is present only when HEADER is given.  Slots are listed from
+// TOS down, in the same order as in the textual output.  Each slot is
+// an object with a "type" and further fields depending on type.
+//
+// DIE's carry the number of the Dwarf that they come from in
+// "dwarf", because DIE's from a dwz alternate file may have the same
+// offsets as DIE's from the main file.  Dwarf's are numbered from 0 in
+// the order of modules, each main Dwarf followed by its alternate
+// file, if any.
+std::unique_ptr <encoder> make_jsonl_encoder ();
+
+// Length-prefixed binary records.  All integers are little-endian:
+//
+//   record := u32 length of the rest of record
+//             str header (empty if not given)
+//             u32 number of slots, slots
+//   str := u32 length, bytes
+//   slot := u8 type, payload
+//
+// Slot types and their payloads are:
+//
+//   1 constant: u8 signed, u64 value, str domain name
+//   2 string: str
+//   3 sequence: u32 count, slots
+//   4 Dwarf: str name
+//   5 CU: u64 offset
+//   6 DIE: u64 offset, u64 offset of its unit, u32 tag, u32 number
+//          of its Dwarf (as "dwarf" in jsonl)
+//   7 attribute: u32 name, u32 form, u32 count, slots (values)
+//   8 location expression: u64 low, u64 high, u32 count, slots (ops)
+//   9 location operation: u64 offset, u32 opcode, u32 count,
+//                         slots (operands)
+//  10 address set: u32 count, count * (u64 start, u64 length)
+//  11 ELF symbol: u32 index, u64 value, u64 size, u8 info, u8 other,
+//                 str name
+//   0 other: no payload
+std::unique_ptr <encoder> make_binary_encoder ();
+
+#endif /* _ENCODER_H_ */
@@ -55,7 +55,7 @@ merge_options (std::vector <ext_option> const &ext_opts)
   return opts;
 }
 
-ext_shopt help, version, longarg;
+ext_shopt help, version, longarg, output_format, batch, profile, explain;
 
 std::vector <ext_option> ext_options = {
   {'q', "silent", ext_argument::no, ""},
@@ -104,6 +104,24 @@ std::vector <ext_option> ext_options = {
 	Suppress printing filename on output.  This is the default
 	when there is less than two files to search.
 
+)docstring"},
+
+  {'j', "jobs", ext_argument::required ("N"), R"docstring(
+
+	Search input files using *N* worker threads.  Output is
+	buffered and shown in the same order as it would be without
+	this option.  If *N* is 0, the number of available processors
+	is used.
+
+	Files are searched in parallel only if all arguments passed
+	through ``-a`` and ``--a`` are strings or constants.  Otherwise
+	this option has no effect.
+
+	Queries that start with ``entry`` (and do not use ``pos``) are
+	in addition split by units, so that even a single large file
+	is searched in parallel.  In that case each worker opens the
+	file anew.
+
 )docstring"},
 
   {'f', "file", ext_argument::required ("FILE"), R"docstring(
@@ -112,6 +130,87 @@ std::vector <ext_option> ext_options = {
 	file is read and run over the input file(s).  At most one
 	``-e`` or ``-f`` option shall be present.
 
+)docstring"},
+
+  {output_format, "format", ext_argument::required ("FORMAT"), R"docstring(
+
+	Select how query results are written.  *FORMAT* is one of:
+
+	- ``text``, the default human-readable output.
+
+	- ``jsonl``, one JSON object per result.  Values are described
+	  by their type and raw properties, such as offsets and tag
+	  codes, so that tools don't need to parse the text.
+
+	- ``binary``, length-prefixed binary records with the same
+	  contents as ``jsonl``.  The layout is described in
+	  ``dwgrep/encoder.hh`` in the source distribution.
+
+	Output of ``-c`` is not affected.
+
+)docstring"},
+
+  {batch, "batch", ext_argument::required ("FILE"), R"docstring(
+
+	Read arguments from *FILE*, one per line, and run the query
+	once for each of them.  If *FILE* is ``-``, standard input is
+	read.  Each line is evaluated as if passed through ``--a``, and
+	the values are pushed after all other arguments.  Blank lines
+	are skipped.
+
+	Files to search are opened once for the whole batch, so
+	indices that a query builds, such as the one behind
+	``addrdie``, are reused by subsequent lines.  Results are
+	written as each line is processed, and prefixed with the line's
+	value unless ``-h`` is given::
+
+		$ printf '0x4004b2\n0x4004c0\n' | \
+		    dwgrep a.out --batch - -e 'addrdie name'
+
+	``-j`` has no effect in this mode.
+
+)docstring"},
+
+  {profile, "profile", ext_argument::no, R"docstring(
+
+	Collect statistics of how each part of the query is executed,
+	and show them on standard error when dwgrep exits.  There is
+	one row for each part, nested parts are indented below their
+	parents.  The columns are:
+
+	- ``calls``, how many times the part was asked for a value.
+
+	- ``yields``, how many values it produced.  For assertions,
+	  how many values passed.
+
+	- ``rejects``, how many values an assertion rejected.
+
+	- ``incl ms`` and ``self ms``, time spent in the part, with
+	  and without time spent in nested parts and in parts that it
+	  takes values from.
+
+	Instrumentation slows the query down.  ``-j`` has no effect
+	with this option.
+
+)docstring"},
+
+  {explain, "explain", ext_argument::no, R"docstring(
+
+	Show what the query is built into, and exit without running
+	it.  The output starts with the query's syntax tree after
+	simplification, followed by one row for each part of the
+	query, nested parts indented below their parents, as with
+	``--profile``.  Each row shows how many bytes of execution
+	state the part needs including its nested parts, the part
+	itself, and the op or predicate that implements it.  This
+	shows e.g. whether ``?(...)`` or assertions that follow a
+	word were folded into a cheaper operation.
+
+	Queries are built with types of the values that they are
+	run on in mind, so that overloaded words can be resolved
+	up front.  When files are given, the query is shown as it
+	is built for the first of them.
+
 )docstring"},
 
   {help, "help", ext_argument::no, R"docstring(
@@ -157,5 +157,6 @@ struct ext_option
 std::map <int, std::pair <std::vector <std::string>, std::string>>
 merge_options (std::vector <ext_option> const &ext_opts);
 
-extern ext_shopt help, version, longarg;
+extern ext_shopt help, version, longarg, output_format, batch, profile,
+  explain;
 extern std::vector <ext_option> ext_options;
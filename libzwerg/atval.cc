@@ -324,7 +324,7 @@ namespace
 value_aset
 die_ranges (Dwarf_Die die)
 {
-  coverage cov;
+  coverage::builder cov;
   Dwarf_Addr base; // Cache for dwarf_ranges.
   for (ptrdiff_t off = 0;;)
     {
@@ -338,7 +338,7 @@ die_ranges (Dwarf_Die die)
       cov.add (start, end - start);
     }
 
-  return value_aset {cov, 0};
+  return value_aset {cov.build (), 0};
 }
 
 namespace
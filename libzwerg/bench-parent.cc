@@ -0,0 +1,131 @@
+/*
+   Copyright (C) 2014 Red Hat, Inc.
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+// Measures cost of `parent' lookups.  Run as:
+//
+//	bench-parent FILE [ROUNDS]
+//
+// All DIE's of FILE are collected first.  Then the parent of each of
+// them is looked up, once in a fresh context, where units are walked
+// on demand, and ROUNDS more times when every unit is cached.  Last,
+// every DIE is walked up to its unit DIE, the way `parent*' does it.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "cache.hh"
+#include "dwfl_context.hh"
+#include "dwit.hh"
+#include "value-dw.hh"
+
+namespace
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  std::vector <Dwarf_Die>
+  collect_dies (dwfl_context &dwctx)
+  {
+    std::vector <Dwarf_Die> ret;
+    for (auto it = dwfl_module_iterator {dwctx.get_dwfl ()};
+	 it != dwfl_module_iterator::end (); ++it)
+      for (all_dies_iterator jt {(*it).dwarf ()};
+	   jt != all_dies_iterator::end (); ++jt)
+	ret.push_back (**jt);
+    return ret;
+  }
+
+  void
+  report (char const *what, bench_clock::time_point start, size_t calls)
+  {
+    auto ns = std::chrono::duration_cast <std::chrono::nanoseconds>
+      (bench_clock::now () - start).count ();
+    std::cout << std::left << std::setw (12) << what << std::right
+	      << std::setw (12) << calls << " calls "
+	      << std::fixed << std::setprecision (1)
+	      << std::setw (10) << (calls != 0 ? (double) ns / calls : 0.)
+	      << " ns/call" << std::endl;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cerr << "Usage: " << argv[0] << " FILE [ROUNDS]" << std::endl;
+      return 2;
+    }
+
+  int rounds = argc > 2 ? std::atoi (argv[2]) : 5;
+
+  try
+    {
+      value_dwarf vdw {argv[1], 0, doneness::raw};
+      dwfl_context &dwctx = *vdw.get_dwctx ();
+      std::vector <Dwarf_Die> dies = collect_dies (dwctx);
+
+      auto start = bench_clock::now ();
+      for (auto &die: dies)
+	dwctx.find_parent (die);
+      report ("cold", start, dies.size ());
+
+      start = bench_clock::now ();
+      for (int i = 0; i < rounds; ++i)
+	for (auto &die: dies)
+	  dwctx.find_parent (die);
+      report ("warm", start, dies.size () * rounds);
+
+      size_t calls = 0;
+      start = bench_clock::now ();
+      for (auto die: dies)
+	{
+	  Dwarf *dw = dwarf_cu_getdwarf (die.cu);
+	  for (Dwarf_Off off; (off = dwctx.find_parent (die))
+				!= parent_cache::no_off; ++calls)
+	    if (dwarf_offdie (dw, off, &die) == nullptr)
+	      throw_libdw ();
+	  ++calls;
+	}
+      report ("chain", start, calls);
+
+      auto const &st = dwctx.get_parent_cache ().get_stats ();
+      std::cout << "chain hits " << st.m_chain_hits
+		<< ", unit memo hits " << st.m_unit_memo_hits
+		<< ", unit hits " << st.m_unit_hits
+		<< ", walks " << st.m_walks << std::endl;
+    }
+  catch (std::runtime_error const &e)
+    {
+      std::cerr << e.what () << std::endl;
+      return 1;
+    }
+
+  return 0;
+}
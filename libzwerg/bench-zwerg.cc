@@ -0,0 +1,439 @@
+/*
+   Copyright (C) 2014 Red Hat, Inc.
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+// Runs a corpus of queries against Dwarf files, and reports how long
+// each of them took.  Run as:
+//
+//	bench-zwerg [OPTION]... FILE...
+//
+// Each query is run on each FILE in a separate process, so that
+// caches and memory use of one run don't leak into the next one.  The
+// query is run ROUNDS times on the same Dwarf value.  The first round
+// is reported separately, as it populates the caches.
+//
+// The output is one line per run with tab-separated columns, preceded
+// by a line naming them:
+//
+//	file		name of the Dwarf file
+//	query		name of the query
+//	rounds		number of rounds
+//	results		number of results of one round
+//	dies		number of DIE's in the file
+//	cold_s		duration of the first round in seconds
+//	mean_s		mean duration of a round in seconds
+//	dies_per_s	DIE's in the file divided by mean_s.  This is the
+//			same whatever the query does with the DIE's, so
+//			only compare it between runs of the same query.
+//	allocs		operator new calls per round
+//	peak_rss_kb	peak resident set size of the run
+//
+// A run that fails has "-" in every column but file and query.
+//
+// With --synth=N, a C file with N of each of structures, typedefs and
+// functions is generated and compiled with $CC (or cc), and the
+// resulting object is benchmarked along with the other files.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "libzwerg.hh"
+#include "libzwerg-dw.h"
+
+namespace
+{
+  std::atomic <size_t> n_allocs {0};
+}
+
+void *
+operator new (size_t size)
+{
+  ++n_allocs;
+  if (void *ret = std::malloc (size != 0 ? size : 1))
+    return ret;
+  throw std::bad_alloc {};
+}
+
+void
+operator delete (void *ptr) noexcept
+{
+  std::free (ptr);
+}
+
+namespace
+{
+  using bench_clock = std::chrono::steady_clock;
+
+  struct bench_query
+  {
+    std::string m_name;
+    std::string m_text;
+  };
+
+  std::vector <bench_query>
+  default_queries ()
+  {
+    return {
+      {"entry",		"entry"},
+      {"entry-raw",	"raw entry"},
+      {"tag",		"entry ?TAG_subprogram"},
+      {"name",		"entry ?(name == \"main\")"},
+      {"child*",	"unit root child*"},
+      {"parent*",	"entry parent*"},
+      {"match",		"entry ?(@AT_decl_file \".*\\\\.h$\" ?match)"},
+      {"type*",		"entry @AT_type*"},
+      {"capture",	"entry ?TAG_subprogram [child ?TAG_formal_parameter]"},
+      {"bind",		"entry ?TAG_subprogram (|F| F child "
+			"?(@AT_type == F @AT_type))"},
+    };
+  }
+
+  double
+  seconds_since (bench_clock::time_point start)
+  {
+    return std::chrono::duration <double> (bench_clock::now () - start)
+      .count ();
+  }
+
+  size_t
+  run_query (zw_query const &query, zw_value const &dw)
+  {
+    std::unique_ptr <zw_stack, zw_deleter> stack
+	{zw_stack_init (zw_throw_on_error {})};
+    zw_stack_push (stack.get (), &dw, zw_throw_on_error {});
+
+    size_t ret = 0;
+    std::unique_ptr <zw_result, zw_deleter> result
+	{zw_query_execute (&query, stack.get (), zw_throw_on_error {})};
+    while (zw_result_next (*result) != nullptr)
+      ++ret;
+    return ret;
+  }
+
+  void
+  bench (zw_vocabulary const &voc, char const *fn,
+	 bench_query const &bq, int rounds)
+  {
+    std::unique_ptr <zw_query, zw_deleter> query
+	{zw_query_parse_len (&voc, bq.m_text.c_str (), bq.m_text.length (),
+			     zw_throw_on_error {})};
+    std::unique_ptr <zw_query, zw_deleter> all_dies
+	{zw_query_parse (&voc, "raw entry", zw_throw_on_error {})};
+    std::unique_ptr <zw_value, zw_deleter> dw
+	{zw_value_init_dwarf (fn, 0, zw_throw_on_error {})};
+
+    size_t allocs0 = n_allocs;
+    auto start = bench_clock::now ();
+    size_t results = run_query (*query, *dw);
+    double cold = seconds_since (start);
+
+    for (int i = 1; i < rounds; ++i)
+      run_query (*query, *dw);
+    double mean = seconds_since (start) / rounds;
+    size_t allocs = (n_allocs - allocs0) / rounds;
+
+    struct rusage ru;
+    getrusage (RUSAGE_SELF, &ru);
+
+    std::unique_ptr <zw_value, zw_deleter> dw2
+	{zw_value_init_dwarf (fn, 0, zw_throw_on_error {})};
+    size_t dies = run_query (*all_dies, *dw2);
+
+    std::cout << fn << '\t' << bq.m_name << '\t' << rounds
+	      << '\t' << results << '\t' << dies
+	      << '\t' << cold << '\t' << mean
+	      << '\t' << (size_t) (mean > 0 ? dies / mean : 0)
+	      << '\t' << allocs << '\t' << ru.ru_maxrss << std::endl;
+  }
+
+  // Run the benchmark in a child process.  Return true if it
+  // succeeded.
+  bool
+  bench_in_child (zw_vocabulary const &voc, char const *fn,
+		  bench_query const &bq, int rounds)
+  {
+    std::cout << std::flush;
+    pid_t pid = fork ();
+    if (pid < 0)
+      {
+	std::cerr << "bench-zwerg: fork: " << std::strerror (errno)
+		  << std::endl;
+	return false;
+      }
+
+    if (pid == 0)
+      try
+	{
+	  bench (voc, fn, bq, rounds);
+	  std::exit (0);
+	}
+      catch (std::runtime_error const &e)
+	{
+	  std::cerr << "bench-zwerg: " << fn << ": " << bq.m_name << ": "
+		    << e.what () << std::endl;
+	  std::exit (1);
+	}
+
+    int status;
+    if (waitpid (pid, &status, 0) < 0
+	|| ! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+      {
+	std::cout << fn << '\t' << bq.m_name;
+	for (int i = 0; i < 8; ++i)
+	  std::cout << "\t-";
+	std::cout << std::endl;
+	return false;
+      }
+
+    return true;
+  }
+
+  // Write to FN a C file with N structures, typedefs and functions,
+  // each referring to the previous one, so that there are long type
+  // chains, nested scopes and location lists to go through.
+  void
+  write_synth (std::string const &fn, unsigned n)
+  {
+    std::ofstream os {fn};
+    os << "struct s0 { int a; };\n"
+       << "typedef struct s0 t0;\n"
+       << "int f0 (t0 *p, int x) { return p->a + x; }\n";
+    for (unsigned i = 1; i <= n; ++i)
+      os << "struct s" << i << " {\n"
+	 << "  int a;\n"
+	 << "  long b[" << i % 7 + 1 << "];\n"
+	 << "  struct s" << i - 1 << " *prev;\n"
+	 << "  const char *name;\n"
+	 << "};\n"
+	 << "typedef struct s" << i << " t" << i << ";\n"
+	 << "int\n"
+	 << "f" << i << " (t" << i << " *p, int x)\n"
+	 << "{\n"
+	 << "  int y = x * " << i << ";\n"
+	 << "  for (int j = 0; j < x; ++j)\n"
+	 << "    {\n"
+	 << "      int z = y + p->a + j;\n"
+	 << "      if (z > " << i << ")\n"
+	 << "        y += f" << i - 1 << " ((void *) p->prev, z);\n"
+	 << "    }\n"
+	 << "  return y + (int) p->b[0];\n"
+	 << "}\n";
+  }
+
+  // Generate and compile a synthetic test file in DIR.  Return the
+  // name of the object file, or an empty string on failure.
+  std::string
+  build_synth (std::string const &dir, unsigned n)
+  {
+    std::string src = dir + "/synth.c";
+    std::string obj = dir + "/synth.o";
+    write_synth (src, n);
+
+    char const *cc = std::getenv ("CC");
+    std::string cmd = std::string (cc != nullptr ? cc : "cc")
+      + " -g -O2 -c " + src + " -o " + obj;
+    if (std::system (cmd.c_str ()) != 0)
+      {
+	std::cerr << "bench-zwerg: `" << cmd << "' failed" << std::endl;
+	return "";
+      }
+
+    return obj;
+  }
+
+  // Remove what build_synth created in DIR, and DIR itself.
+  void
+  remove_synth (std::string const &dir)
+  {
+    unlink ((dir + "/synth.c").c_str ());
+    unlink ((dir + "/synth.o").c_str ());
+    rmdir (dir.c_str ());
+  }
+
+  bool
+  add_query (std::vector <bench_query> &queries, char const *arg,
+	     bool from_file)
+  {
+    char const *eq = std::strchr (arg, '=');
+    if (eq == nullptr || eq == arg)
+      {
+	std::cerr << "bench-zwerg: expected NAME="
+		  << (from_file ? "FILE" : "QUERY")
+		  << ", got `" << arg << "'" << std::endl;
+	return false;
+      }
+
+    std::string text = eq + 1;
+    if (from_file)
+      {
+	std::ifstream is {text};
+	if (! is)
+	  {
+	    std::cerr << "bench-zwerg: can't read `" << text << "'"
+		      << std::endl;
+	    return false;
+	  }
+	std::stringstream ss;
+	ss << is.rdbuf ();
+	text = ss.str ();
+      }
+
+    queries.push_back ({std::string (arg, eq), text});
+    return true;
+  }
+
+  void
+  usage (char const *argv0)
+  {
+    std::cerr << "Usage: " << argv0 << " [OPTION]... FILE...\n"
+	      << "  -r, --rounds=N          run each query N times (default 5)\n"
+	      << "  -s, --synth=N           also benchmark a generated file\n"
+	      << "                          with N functions\n"
+	      << "  -q, --query=NAME=QUERY  add QUERY to the corpus\n"
+	      << "  -f, --query-file=NAME=FILE\n"
+	      << "                          add query in FILE to the corpus\n"
+	      << "  -o, --only=NAME         only run query NAME\n";
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  int rounds = 5;
+  unsigned synth = 0;
+  std::vector <bench_query> queries = default_queries ();
+  std::vector <std::string> only;
+
+  static struct option const long_options[] = {
+    {"rounds", required_argument, nullptr, 'r'},
+    {"synth", required_argument, nullptr, 's'},
+    {"query", required_argument, nullptr, 'q'},
+    {"query-file", required_argument, nullptr, 'f'},
+    {"only", required_argument, nullptr, 'o'},
+    {nullptr, 0, nullptr, 0},
+  };
+
+  for (int c; (c = getopt_long (argc, argv, "r:s:q:f:o:",
+				long_options, nullptr)) != -1; )
+    switch (c)
+      {
+      case 'r':
+	rounds = std::atoi (optarg);
+	break;
+      case 's':
+	synth = std::atoi (optarg);
+	break;
+      case 'q':
+      case 'f':
+	if (! add_query (queries, optarg, c == 'f'))
+	  return 2;
+	break;
+      case 'o':
+	only.push_back (optarg);
+	break;
+      default:
+	usage (argv[0]);
+	return 2;
+      }
+
+  std::vector <std::string> files {argv + optind, argv + argc};
+  if ((files.empty () && synth == 0) || rounds < 1)
+    {
+      usage (argv[0]);
+      return 2;
+    }
+
+  char tmpl[] = "/tmp/bench-zwerg.XXXXXX";
+  std::string synth_dir;
+  if (synth != 0)
+    {
+      if (mkdtemp (tmpl) == nullptr)
+	{
+	  std::cerr << "bench-zwerg: mkdtemp: " << std::strerror (errno)
+		    << std::endl;
+	  return 1;
+	}
+      synth_dir = tmpl;
+
+      std::string obj = build_synth (synth_dir, synth);
+      if (obj.empty ())
+	{
+	  remove_synth (synth_dir);
+	  return 1;
+	}
+      files.push_back (obj);
+    }
+
+  int ret = 0;
+  try
+    {
+      std::unique_ptr <zw_vocabulary, zw_deleter> voc
+	  {zw_vocabulary_init (zw_throw_on_error {})};
+      zw_vocabulary_add (voc.get (),
+			 zw_vocabulary_core (zw_throw_on_error {}),
+			 zw_throw_on_error {});
+      zw_vocabulary_add (voc.get (),
+			 zw_vocabulary_dwarf (zw_throw_on_error {}),
+			 zw_throw_on_error {});
+
+      std::cout << "file\tquery\trounds\tresults\tdies\tcold_s\tmean_s"
+		<< "\tdies_per_s\tallocs\tpeak_rss_kb" << std::endl;
+
+      for (auto const &fn: files)
+	for (auto const &bq: queries)
+	  if (only.empty ()
+	      || std::find (only.begin (), only.end (), bq.m_name)
+		  != only.end ())
+	    if (! bench_in_child (*voc, fn.c_str (), bq, rounds))
+	      ret = 1;
+    }
+  catch (std::runtime_error const &e)
+    {
+      std::cerr << "bench-zwerg: " << e.what () << std::endl;
+      ret = 1;
+    }
+
+  if (! synth_dir.empty ())
+    remove_synth (synth_dir);
+
+  return ret;
+}
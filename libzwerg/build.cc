@@ -30,51 +30,94 @@
 #include <algorithm>
 #include <iostream>
 #include <memory>
+#include <sstream>
 
 #include "op.hh"
 #include "tree.hh"
+#include "value-closure.hh"
 #include "value-cst.hh"
 #include "value-seq.hh"
 #include "value-str.hh"
 #include "builtin-closure.hh"
 #include "bindings.hh"
+#include "profile.hh"
 
 namespace
 {
+  // SP is what is known about types of values near TOS where T is
+  // used.  build_exec updates it to what is known after T.
   std::shared_ptr <op>
   build_exec (tree const &t, layout &l, layout::loc rdv_ll,
 	      std::shared_ptr <op> upstream,
-	      bindings &bn, uprefs &up);
+	      bindings &bn, uprefs &up, bool keep_pos,
+	      stack_profile &sp, std::shared_ptr <profile> prof);
 
   std::unique_ptr <pred>
   build_pred (tree const &t, layout &l, layout::loc rdv_ll,
-	      bindings &bn, uprefs &up)
+	      bindings &bn, uprefs &up, bool keep_pos,
+	      stack_profile const &sp, std::shared_ptr <profile> prof);
+
+  // How an overload that a word was pegged to is shown in the output
+  // of profile::format_plan.
+  std::string
+  overload_label (builtin const &ovl)
+  {
+    std::string ret = "overload";
+    auto pm = ovl.protomap ();
+    if (pm.size () == 1)
+      for (auto const &vt: std::get <0> (pm[0]))
+	ret += std::string (" ") + vt.name ();
+    return ret;
+  }
+
+  // Build BI as a predicate, or return nullptr if it isn't one.  If
+  // SP determines what overload BI would dispatch to, the overload is
+  // built directly.
+  std::unique_ptr <pred>
+  build_builtin_pred (builtin const &bi, layout &l, stack_profile const &sp)
+  {
+    if (auto pegged = bi.peg (sp))
+      return pegged->build_pred (l);
+    return bi.build_pred (l);
+  }
+
+  std::unique_ptr <pred>
+  do_build_pred (tree const &t, layout &l, layout::loc rdv_ll,
+		 bindings &bn, uprefs &up, bool keep_pos,
+		 stack_profile const &sp, std::shared_ptr <profile> prof)
   {
     switch (t.m_tt)
       {
       case tree_type::PRED_NOT:
-	return std::make_unique <pred_not> (build_pred (t.child (0), l, rdv_ll, bn, up));
+	return std::make_unique <pred_not>
+	  (build_pred (t.child (0), l, rdv_ll, bn, up, keep_pos, sp, prof));
 
       case tree_type::PRED_OR:
 	return std::make_unique <pred_or>
-	  (build_pred (t.m_children[0], l, rdv_ll, bn, up),
-	   build_pred (t.m_children[1], l, rdv_ll, bn, up));
+	  (build_pred (t.m_children[0], l, rdv_ll, bn, up, keep_pos, sp,
+		       prof),
+	   build_pred (t.m_children[1], l, rdv_ll, bn, up, keep_pos, sp,
+		       prof));
 
       case tree_type::PRED_AND:
 	return std::make_unique <pred_and>
-	  (build_pred (t.m_children[0], l, rdv_ll, bn, up),
-	   build_pred (t.m_children[1], l, rdv_ll, bn, up));
+	  (build_pred (t.m_children[0], l, rdv_ll, bn, up, keep_pos, sp,
+		       prof),
+	   build_pred (t.m_children[1], l, rdv_ll, bn, up, keep_pos, sp,
+		       prof));
 
       case tree_type::PRED_SUBX_ANY:
 	{
 	  assert (t.m_children.size () == 1);
 	  auto origin = std::make_shared <op_origin> (l);
-	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up);
+	  stack_profile sub_sp = sp;
+	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up,
+				keep_pos, sub_sp, prof);
 	  return std::make_unique <pred_subx_any> (op, origin);
 	}
 
       case tree_type::F_BUILTIN:
-	return t.m_builtin->build_pred (l);
+	return build_builtin_pred (*t.m_builtin, l, sp);
 
       case tree_type::CAT:
       case tree_type::NOP:
@@ -101,54 +144,263 @@ namespace
     abort ();
   }
 
+  // Build BI as an op, or as an op_assert if it's a predicate.  SP
+  // is as in build_exec, and if it determines what overload BI would
+  // dispatch to, the overload is built directly.  When profiling, the
+  // statistics are recorded into node N, or into a new node if N is
+  // nullptr.
   std::shared_ptr <op>
   build_builtin (builtin const &bi,
 		 std::shared_ptr <op> upstream,
-		 layout &l)
+		 layout &l, stack_profile &sp,
+		 std::shared_ptr <profile> prof,
+		 profile::node *n = nullptr)
   {
-    if (auto pred = bi.build_pred (l))
-      return std::make_shared <op_assert> (upstream, std::move (pred));
+    if (prof != nullptr && n == nullptr)
+      n = &prof->add (bi.name (), false);
+    size_t start = l.size ();
 
-    auto op = bi.build_exec (l, upstream);
+    std::shared_ptr <builtin const> pegged = bi.peg (sp);
+    builtin const &b = pegged != nullptr ? *pegged : bi;
+
+    if (auto pred = b.build_pred (l))
+      {
+	if (prof != nullptr)
+	  {
+	    n->m_is_pred = true;
+	    n->m_state = l.size () - start;
+	    pred = std::make_unique <pred_profile> (std::move (pred), prof,
+						    *n);
+	    if (pegged != nullptr)
+	      n->m_op = overload_label (*pegged);
+	  }
+	return std::make_shared <op_assert> (upstream, std::move (pred));
+      }
+
+    auto op = b.build_exec (l, upstream);
     assert (op != nullptr);
+    b.stack_effect (sp);
+    if (prof != nullptr)
+      {
+	n->m_state = l.size () - start;
+	op = std::make_shared <op_profile> (op, prof, *n);
+	if (pegged != nullptr)
+	  n->m_op = overload_label (*pegged);
+      }
     return op;
   }
 
+  // If T is a word bound to a builtin, return that builtin.
+  // Otherwise return nullptr.
+  builtin const *
+  find_builtin (tree const &t, bindings &bn, uprefs &up)
+  {
+    if (t.m_tt != tree_type::READ)
+      return nullptr;
+
+    if (const binding *b = bn.find (t.str ()))
+      return b->is_builtin () ? &b->get_builtin () : nullptr;
+
+    if (upref *upr = up.find (t.str ()))
+      return upr->is_builtin () ? &upr->get_builtin () : nullptr;
+
+    return nullptr;
+  }
+
+  // Whether T is a single word bound to a builtin, possibly wrapped in
+  // a scope.  See op_tr_closure.
+  bool
+  is_single_word (tree const &t, bindings &bn, uprefs &up)
+  {
+    if (t.m_tt == tree_type::SCOPE)
+      return is_single_word (t.child (0), bn, up);
+    return t.m_tt == tree_type::F_BUILTIN
+      || find_builtin (t, bn, up) != nullptr;
+  }
+
+  // Whether T is a single word bound to a builtin, whose stack effect
+  // leaves SP as it is.  Such word can be applied to its own results,
+  // as transitive closures do, with SP still holding.
+  bool
+  keeps_profile (tree const &t, bindings &bn, uprefs &up,
+		 stack_profile const &sp)
+  {
+    if (t.m_tt == tree_type::SCOPE)
+      return keeps_profile (t.child (0), bn, up, sp);
+
+    builtin const *bi = t.m_tt == tree_type::F_BUILTIN
+      ? t.m_builtin.get () : find_builtin (t, bn, up);
+    if (bi == nullptr)
+      return false;
+
+    stack_profile after = sp;
+    bi->stack_effect (after);
+    return after == sp;
+  }
+
+  // Build a transitive closure of T.  A single word is built in a
+  // layout of its own, so that the closure can keep a state of it for
+  // each level of depth.
   std::shared_ptr <op>
-  build_exec (tree const &t, layout &l, layout::loc rdv_ll,
-	      std::shared_ptr <op> upstream,
-	      bindings &bn, uprefs &up)
+  build_closure (tree const &t, layout &l, layout::loc rdv_ll,
+		 std::shared_ptr <op> upstream,
+		 bindings &bn, uprefs &up, bool keep_pos,
+		 stack_profile &sp, std::shared_ptr <profile> prof,
+		 op_tr_closure_kind k)
+  {
+    if (is_single_word (t, bn, up))
+      {
+	layout op_l;
+	auto origin = std::make_shared <op_origin> (op_l);
+	auto op = build_exec (t, op_l, rdv_ll, origin, bn, up,
+			      keep_pos, sp, prof);
+	return std::make_shared <op_tr_closure> (l, upstream, op_l,
+						 origin, op, k);
+      }
+
+    auto origin = std::make_shared <op_origin> (l);
+    auto op = build_exec (t, l, rdv_ll, origin, bn, up, keep_pos, sp, prof);
+    return std::make_shared <op_tr_closure> (l, upstream, origin, op, k);
+  }
+
+  std::shared_ptr <op>
+  do_build_exec (tree const &t, layout &l, layout::loc rdv_ll,
+		 std::shared_ptr <op> upstream,
+		 bindings &bn, uprefs &up, bool keep_pos,
+		 stack_profile &sp, std::shared_ptr <profile> prof)
   {
     switch (t.m_tt)
       {
       case tree_type::CAT:
-	for (auto const &ch: t.m_children)
-	  upstream = build_exec (ch, l, rdv_ll, upstream, bn, up);
+	for (size_t i = 0; i < t.m_children.size (); ++i)
+	  {
+	    tree const &ch = t.child (i);
+	    builtin const *bi = find_builtin (ch, bn, up);
+	    if (bi == nullptr)
+	      {
+		upstream = build_exec (ch, l, rdv_ll, upstream,
+				       bn, up, keep_pos, sp, prof);
+		continue;
+	      }
+
+	    // The builtin's node goes before nodes of the assertions
+	    // that follow it.
+	    profile::node *bi_node = nullptr;
+	    if (prof != nullptr)
+	      bi_node = &prof->add (bi->name (), false);
+	    size_t bi_start = l.size ();
+
+	    // The assertions see the stack that the builtin produces.
+	    stack_profile bi_sp = sp;
+	    bi->stack_effect (bi_sp);
+
+	    // Give the builtin a chance to make use of assertions that
+	    // follow it.
+	    std::vector <reducible_pred> preds;
+	    for (; i + 1 < t.m_children.size (); ++i)
+	      {
+		tree const &nt = t.child (i + 1);
+		auto resolve = [&bn, &up] (tree const &rt)
+		  {
+		    return find_builtin (rt, bn, up);
+		  };
+
+		if (nt.m_tt == tree_type::ASSERT)
+		  {
+		    preds.push_back
+		      ({nt, nullptr,
+			build_pred (nt.child (0), l, rdv_ll, bn, up,
+				    keep_pos, bi_sp, prof),
+			resolve});
+		    continue;
+		  }
+
+		builtin const *pbi = find_builtin (nt, bn, up);
+		if (pbi == nullptr)
+		  break;
+
+		size_t pred_start = l.size ();
+		auto pegged = pbi->peg (bi_sp);
+		auto pred = (pegged != nullptr ? *pegged : *pbi).build_pred (l);
+		if (pred == nullptr)
+		  break;
+
+		if (prof != nullptr)
+		  {
+		    profile::node &n = prof->add (pbi->name (), true);
+		    n.m_state = l.size () - pred_start;
+		    pred = std::make_unique <pred_profile>
+		      (std::move (pred), prof, n);
+		    if (pegged != nullptr)
+		      n.m_op = overload_label (*pegged);
+		  }
+
+		preds.push_back ({nt, pbi, std::move (pred), resolve});
+	      }
+
+	    if (! preds.empty ())
+	      if (auto op = bi->build_reduced (l, upstream, preds, keep_pos))
+		{
+		  if (prof != nullptr)
+		    {
+		      // The reduced op covers state of the assertions
+		      // as well.
+		      bi_node->m_state = l.size () - bi_start;
+		      op = std::make_shared <op_profile> (op, prof,
+							  *bi_node);
+		    }
+		  upstream = op;
+		  sp = std::move (bi_sp);
+		  continue;
+		}
+
+	    upstream = build_builtin (*bi, upstream, l, sp, prof, bi_node);
+	    for (auto &rp: preds)
+	      upstream = std::make_shared <op_assert> (upstream,
+						       std::move (rp.m_pred));
+	  }
 	return upstream;
 
       case tree_type::ALT:
 	{
 	  auto merge = std::make_shared <op_merge> (l, upstream);
 
+	  stack_profile merged_sp;
 	  for (size_t i = 0; i < t.m_children.size (); ++i)
 	    {
 	      auto tine = std::make_shared <op_tine> (*merge, i);
-	      auto op = build_exec (t.m_children[i], l, rdv_ll, tine, bn, up);
+	      stack_profile branch_sp = sp;
+	      auto op = build_exec (t.m_children[i], l, rdv_ll, tine,
+				    bn, up, keep_pos, branch_sp, prof);
 	      merge->add_branch (op);
+	      if (i == 0)
+		merged_sp = std::move (branch_sp);
+	      else
+		merge_profile (merged_sp, branch_sp);
 	    }
 
+	  sp = std::move (merged_sp);
 	  return merge;
 	}
 
       case tree_type::OR:
 	{
 	  auto o = std::make_shared <op_or> (l, upstream);
-	  for (auto const &ch: t.m_children)
+	  stack_profile merged_sp;
+	  for (size_t i = 0; i < t.m_children.size (); ++i)
 	    {
 	      auto origin2 = std::make_shared <op_origin> (l);
-	      auto op = build_exec (ch, l, rdv_ll, origin2, bn, up);
+	      stack_profile branch_sp = sp;
+	      auto op = build_exec (t.child (i), l, rdv_ll, origin2, bn, up,
+				    keep_pos, branch_sp, prof);
 	      o->add_branch (origin2, op);
+	      if (i == 0)
+		merged_sp = std::move (branch_sp);
+	      else
+		merge_profile (merged_sp, branch_sp);
 	    }
+
+	  sp = std::move (merged_sp);
 	  return o;
 	}
 
@@ -156,17 +408,12 @@ namespace
 	return std::make_shared <op_nop> (upstream);
 
       case tree_type::F_BUILTIN:
-	{
-	  if (auto pred = build_pred (t, l, rdv_ll, bn, up))
-	    return std::make_shared <op_assert> (upstream, std::move (pred));
-	  auto op = t.m_builtin->build_exec (l, upstream);
-	  assert (op != nullptr);
-	  return op;
-	}
+	return build_builtin (*t.m_builtin, upstream, l, sp, prof);
 
       case tree_type::ASSERT:
 	return std::make_shared <op_assert>
-	  (upstream, build_pred (t.child (0), l, rdv_ll, bn, up));
+	  (upstream, build_pred (t.child (0), l, rdv_ll, bn, up, keep_pos,
+				 sp, prof));
 
       case tree_type::FORMAT:
 	{
@@ -181,68 +428,92 @@ namespace
 	      else
 		{
 		  auto origin2 = std::make_shared <op_origin> (l);
-		  auto op = build_exec (tree, l, rdv_ll, origin2, bn, up);
+		  stack_profile sub_sp = sp;
+		  auto op = build_exec (tree, l, rdv_ll, origin2, bn, up,
+					keep_pos, sub_sp, prof);
 		  strgr = std::make_shared <stringer_op> (l, strgr,
 							  origin2, op);
 		}
 	    }
 
+	  sp.push_back (value_str::vtype);
 	  return std::make_shared <op_format> (l, upstream, s_origin, strgr);
 	}
 
       case tree_type::CONST:
 	{
 	  auto val = std::make_unique <value_cst> (t.cst (), 0);
+	  sp.push_back (value_cst::vtype);
 	  return std::make_shared <op_const> (upstream, std::move (val));
 	}
 
       case tree_type::STR:
 	{
 	  auto val = std::make_unique <value_str> (std::string (t.str ()), 0);
+	  sp.push_back (value_str::vtype);
 	  return std::make_shared <op_const> (upstream, std::move (val));
 	}
 
       case tree_type::EMPTY_LIST:
 	{
 	  auto val = std::make_unique <value_seq> (value_seq::seq_t {}, 0);
+	  sp.push_back (value_seq::vtype);
 	  return std::make_shared <op_const> (upstream, std::move (val));
 	}
 
       case tree_type::CAPTURE:
 	{
 	  auto origin = std::make_shared <op_origin> (l);
-	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up);
+	  stack_profile sub_sp = sp;
+	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up,
+				keep_pos, sub_sp, prof);
+	  sp.push_back (value_seq::vtype);
 	  return std::make_shared <op_capture> (upstream, origin, op);
 	}
 
       case tree_type::SUBX_EVAL:
 	{
 	  auto origin = std::make_shared <op_origin> (l);
-	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up);
+	  stack_profile sub_sp = sp;
+	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up,
+				keep_pos, sub_sp, prof);
+	  sp.clear ();
 	  return std::make_shared <op_subx> (l, upstream, origin, op,
 					     t.cst ().value ().uval ());
 	}
 
       case tree_type::CLOSE_STAR:
 	{
-	  auto origin = std::make_shared <op_origin> (l);
-	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up);
-	  return std::make_shared <op_tr_closure> (l, upstream, origin, op,
-						   op_tr_closure_kind::star);
+	  // The body is applied to its own results, so only a profile
+	  // that it keeps is known to hold for all its applications.
+	  // Stacks that the body wasn't applied to at all come out as
+	  // they came in.
+	  stack_profile in_sp = sp;
+	  if (! keeps_profile (t.child (0), bn, up, sp))
+	    sp.clear ();
+	  auto ret = build_closure (t.child (0), l, rdv_ll, upstream, bn,
+				    up, keep_pos, sp, prof,
+				    op_tr_closure_kind::star);
+	  merge_profile (sp, in_sp);
+	  return ret;
 	}
 
       case tree_type::CLOSE_PLUS:
 	{
-	  auto origin = std::make_shared <op_origin> (l);
-	  auto op = build_exec (t.child (0), l, rdv_ll, origin, bn, up);
-	  return std::make_shared <op_tr_closure> (l, upstream, origin, op,
-						   op_tr_closure_kind::plus);
+	  // The body is applied to its own results, so only a profile
+	  // that it keeps is known to hold for all its applications.
+	  if (! keeps_profile (t.child (0), bn, up, sp))
+	    sp.clear ();
+	  return build_closure (t.child (0), l, rdv_ll, upstream, bn, up,
+				keep_pos, sp, prof,
+				op_tr_closure_kind::plus);
 	}
 
       case tree_type::SCOPE:
 	{
 	  bindings scope {bn};
-	  return build_exec (t.child (0), l, rdv_ll, upstream, scope, up);
+	  return build_exec (t.child (0), l, rdv_ll, upstream, scope, up,
+			     keep_pos, sp, prof);
 	}
 
       case tree_type::BLOCK:
@@ -252,8 +523,9 @@ namespace
 	  layout inner_l;
 	  layout::loc inner_rdv_ll = op_apply::reserve_rendezvous (inner_l);
 	  auto origin = std::make_shared <op_origin> (inner_l);
+	  stack_profile inner_sp;
 	  auto op = build_exec (t.child (0), inner_l, inner_rdv_ll, origin,
-				inner_bn, inner_up);
+				inner_bn, inner_up, keep_pos, inner_sp, prof);
 
 	  std::map <unsigned, std::string> refd_ids = inner_up.refd_ids ();
 	  // Walk the refd names in backward order of their ID, so that
@@ -276,6 +548,7 @@ namespace
 							 rdv_ll);
 	      }
 
+	  sp.push_back (value_closure::vtype);
 	  return std::make_shared <op_lex_closure> (upstream, inner_l,
 						    inner_rdv_ll, origin, op,
 						    refd_ids.size ());
@@ -285,6 +558,8 @@ namespace
 	{
 	  auto ret = std::make_shared <op_bind> (l, upstream);
 	  bn.bind (t.str (), *ret);
+	  if (! sp.empty ())
+	    sp.pop_back ();
 	  return ret;
 	}
 
@@ -293,19 +568,23 @@ namespace
 	  if (const binding *b = bn.find (t.str ()))
 	    {
 	      if (b->is_builtin ())
-		return build_builtin (b->get_builtin (), upstream, l);
+		return build_builtin (b->get_builtin (), upstream, l, sp,
+				      prof);
 
 	      auto op = std::make_shared <op_read> (upstream, b->get_bind ());
+	      sp.clear ();
 	      return std::make_shared <op_apply> (l, op, true);
 	    }
 
 	  if (upref *upr = up.find (t.str ()))
 	    {
 	      if (upr->is_builtin ())
-		return build_builtin (upr->get_builtin (), upstream, l);
+		return build_builtin (upr->get_builtin (), upstream, l, sp,
+				      prof);
 
 	      auto op = std::make_shared <op_upread> (upstream, upr->get_id (),
 						      rdv_ll);
+	      sp.clear ();
 	      return std::make_shared <op_apply> (l, op, true);
 	    }
 
@@ -321,18 +600,27 @@ namespace
 	{
 	  auto cond_subl = l;
 	  auto cond_origin = std::make_shared <op_origin> (cond_subl);
+	  stack_profile cond_sp = sp;
 	  auto cond_op = build_exec (t.child (0), cond_subl, rdv_ll,
-				     cond_origin, bn, up);
+				     cond_origin, bn, up, keep_pos, cond_sp,
+				     prof);
 
 	  auto then_subl = l;
 	  auto then_origin = std::make_shared <op_origin> (then_subl);
+	  stack_profile then_sp = sp;
 	  auto then_op = build_exec (t.child (1), then_subl, rdv_ll,
-				     then_origin, bn, up);
+				     then_origin, bn, up, keep_pos, then_sp,
+				     prof);
 
 	  auto else_subl = l;
 	  auto else_origin = std::make_shared <op_origin> (else_subl);
+	  stack_profile else_sp = sp;
 	  auto else_op = build_exec (t.child (2), else_subl, rdv_ll,
-				     else_origin, bn, up);
+				     else_origin, bn, up, keep_pos, else_sp,
+				     prof);
+
+	  sp = std::move (then_sp);
+	  merge_profile (sp, else_sp);
 
 	  l.add_union ({cond_subl, then_subl, else_subl});
 	  return std::make_shared <op_ifelse> (l, upstream,
@@ -351,15 +639,136 @@ namespace
 
     abort ();
   }
+
+  // How a part of the query built from T is called in the output of
+  // profile::format.
+  std::string
+  profile_label (tree const &t)
+  {
+    switch (t.m_tt)
+      {
+      case tree_type::READ:
+	return t.str ();
+      case tree_type::F_BUILTIN:
+	return t.m_builtin->name ();
+      case tree_type::BIND:
+	return "->" + t.str ();
+      case tree_type::CONST:
+	{
+	  std::stringstream ss;
+	  ss << t.cst ();
+	  return ss.str ();
+	}
+      case tree_type::STR:
+	return "\"" + t.str () + "\"";
+      case tree_type::FORMAT:
+	{
+	  std::string ret = "\"";
+	  for (auto const &ch: t.m_children)
+	    ret += ch.m_tt == tree_type::STR ? ch.str () : "%(...%)";
+	  return ret + "\"";
+	}
+      case tree_type::EMPTY_LIST:
+	return "[]";
+      case tree_type::CAPTURE:
+	return "[...]";
+      case tree_type::SUBX_EVAL:
+	return "(...)";
+      case tree_type::CLOSE_STAR:
+	return "(...)*";
+      case tree_type::CLOSE_PLUS:
+	return "(...)+";
+      case tree_type::ALT:
+	return "(..., ...)";
+      case tree_type::OR:
+	return "(... || ...)";
+      case tree_type::IFELSE:
+	return "if ... then ... else ...";
+      case tree_type::BLOCK:
+	return "{...}";
+      case tree_type::NOP:
+	return "nop";
+      case tree_type::F_DEBUG:
+	return "debug";
+      case tree_type::PRED_NOT:
+	return "!";
+      case tree_type::PRED_AND:
+	return "&&";
+      case tree_type::PRED_OR:
+	return "||";
+      case tree_type::PRED_SUBX_ANY:
+	return "?(...)";
+      case tree_type::CAT:
+      case tree_type::SCOPE:
+      case tree_type::ASSERT:
+	break;
+      }
+    return "";
+  }
+
+  std::unique_ptr <pred>
+  build_pred (tree const &t, layout &l, layout::loc rdv_ll,
+	      bindings &bn, uprefs &up, bool keep_pos,
+	      stack_profile const &sp, std::shared_ptr <profile> prof)
+  {
+    if (prof == nullptr)
+      return do_build_pred (t, l, rdv_ll, bn, up, keep_pos, sp, prof);
+
+    profile::node &n = prof->open (profile_label (t), true);
+    size_t start = l.size ();
+    auto pred = do_build_pred (t, l, rdv_ll, bn, up, keep_pos, sp, prof);
+    n.m_state = l.size () - start;
+    prof->close ();
+    return std::make_unique <pred_profile> (std::move (pred), prof, n);
+  }
+
+  std::shared_ptr <op>
+  build_exec (tree const &t, layout &l, layout::loc rdv_ll,
+	      std::shared_ptr <op> upstream,
+	      bindings &bn, uprefs &up, bool keep_pos,
+	      stack_profile &sp, std::shared_ptr <profile> prof)
+  {
+    // CAT and SCOPE have no op of their own, and assertions are
+    // profiled through their predicates.  Builtins are profiled by
+    // build_builtin, which knows whether they are ops or predicates.
+    if (prof == nullptr
+	|| t.m_tt == tree_type::CAT || t.m_tt == tree_type::SCOPE
+	|| t.m_tt == tree_type::ASSERT || t.m_tt == tree_type::F_BUILTIN
+	|| find_builtin (t, bn, up) != nullptr)
+      return do_build_exec (t, l, rdv_ll, upstream, bn, up, keep_pos, sp,
+			    prof);
+
+    profile::node &n = prof->open (profile_label (t), false);
+    size_t start = l.size ();
+    auto op = do_build_exec (t, l, rdv_ll, upstream, bn, up, keep_pos, sp,
+			     prof);
+    n.m_state = l.size () - start;
+    prof->close ();
+    return std::make_shared <op_profile> (op, prof, n);
+  }
 }
 
 std::shared_ptr <op>
 tree::build_exec (layout &l, std::shared_ptr <op> upstream,
-		  vocabulary const &voc) const
+		  vocabulary const &voc, stack_profile const &input,
+		  std::shared_ptr <profile> prof) const
 {
   uprefs up;
   bindings root {voc};
   bindings bn {root};
   layout::loc no_ll {0xdeadbeef};
-  return ::build_exec (*this, l, no_ll, upstream, bn, up);
+
+  // Builtins may pick a faster strategy that produces the same values
+  // at different positions.  That's only allowed if the positions
+  // can't be observed.
+  bool keep_pos = uses_pos ();
+  stack_profile sp = input;
+  auto op = ::build_exec (*this, l, no_ll, upstream, bn, up, keep_pos, sp,
+			  prof);
+  if (prof != nullptr)
+    {
+      prof->root ().m_state = l.size ();
+      op = std::make_shared <op_profile> (op, prof, prof->root ());
+    }
+  return op;
 }
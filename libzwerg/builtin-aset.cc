@@ -107,6 +107,13 @@ op_elem_aset::operate (std::unique_ptr <value_aset> val) const
     (val->get_coverage (), true);
 }
 
+// Elements of a set are distinct, and no elem applies to them.
+bool
+op_elem_aset::acyclic (stack &stk) const
+{
+  return true;
+}
+
 std::string
 op_elem_aset::docstring ()
 {
@@ -120,6 +127,12 @@ op_relem_aset::operate (std::unique_ptr <value_aset> val) const
     (val->get_coverage (), false);
 }
 
+bool
+op_relem_aset::acyclic (stack &stk) const
+{
+  return true;
+}
+
 std::string
 op_relem_aset::docstring ()
 {
@@ -498,13 +511,7 @@ value_aset
 op_overlap_aset_aset::operate (std::unique_ptr <value_aset> a,
 			       std::unique_ptr <value_aset> b) const
 {
-  coverage ret;
-  for (size_t i = 0; i < b->get_coverage ().size (); ++i)
-    {
-      auto range = b->get_coverage ().at (i);
-      auto cov = a->get_coverage ().intersect (range.start, range.length);
-      ret.add_all (cov);
-    }
+  auto ret = a->get_coverage ().intersect (b->get_coverage ());
   return value_aset {std::move (ret), 0};
 }
 
@@ -42,6 +42,7 @@ struct op_elem_aset
   std::unique_ptr <value_producer <value_cst>>
   operate (std::unique_ptr <value_aset> val) const override;
 
+  bool acyclic (stack &stk) const override;
   static std::string docstring ();
 };
 
@@ -53,6 +54,7 @@ struct op_relem_aset
   std::unique_ptr <value_producer <value_cst>>
   operate (std::unique_ptr <value_aset> val) const override;
 
+  bool acyclic (stack &stk) const override;
   static std::string docstring ();
 };
 
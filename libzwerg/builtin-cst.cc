@@ -98,6 +98,12 @@ builtin_constant::docstring () const
   return val->get_constant ().dom ()->docstring ();
 }
 
+void
+builtin_constant::stack_effect (stack_profile &profile) const
+{
+  profile.push_back (m_value->get_type ());
+}
+
 
 namespace
 {
@@ -261,6 +267,14 @@ as T_CONST, T_DIE, T_STR, etc.).
 )docstring";
 }
 
+void
+op_type::stack_effect (stack_profile &profile)
+{
+  if (! profile.empty ())
+    profile.pop_back ();
+  profile.push_back (value_cst::vtype);
+}
+
 stack::uptr
 op_pos::next (scon &sc) const
 {
@@ -329,3 +343,11 @@ Note that *every* function counts its elements anew::
 
 )docstring";
 }
+
+void
+op_pos::stack_effect (stack_profile &profile)
+{
+  if (! profile.empty ())
+    profile.pop_back ();
+  profile.push_back (value_cst::vtype);
+}
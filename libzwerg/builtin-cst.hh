@@ -52,6 +52,7 @@ public:
   char const *name () const override;
 
   std::string docstring () const override;
+  void stack_effect (stack_profile &profile) const override;
 };
 
 struct builtin_hex
@@ -119,6 +120,7 @@ struct op_type
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 struct op_pos
@@ -129,6 +131,7 @@ struct op_pos
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 #endif /* _BUILTIN_CST_H_ */
@@ -28,6 +28,7 @@
    not, see <http://www.gnu.org/licenses/>.  */
 
 #include "builtin-dw-abbrev.hh"
+#include "cache.hh"
 #include "dwpp.hh"
 #include "dwcst.hh"
 #include "dwit.hh"
@@ -365,43 +366,35 @@ namespace
     std::shared_ptr <dwfl_context> m_dwctx;
     std::vector <Dwarf *> m_dwarfs;
     std::vector <Dwarf *>::iterator m_it;
-    std::vector <Dwarf_Off> m_seen;
-    cu_iterator m_cuit;
+
+    // Units of the current Dwarf that stand for its abbreviation
+    // units, and the next one to yield.
+    std::vector <Dwarf_CU *> const *m_cus;
+    size_t m_j;
     size_t m_i;
 
     producer_abbrev_dwarf (std::shared_ptr <dwfl_context> dwctx)
       : m_dwctx {(assert (dwctx != nullptr), dwctx)}
       , m_dwarfs {all_dwarfs (*dwctx)}
       , m_it {m_dwarfs.begin ()}
-      , m_cuit {cu_iterator::end ()}
+      , m_cus {nullptr}
+      , m_j {0}
       , m_i {0}
     {}
 
     std::unique_ptr <value_abbrev_unit>
     next () override
     {
-      do
+      while (m_cus == nullptr || m_j == m_cus->size ())
 	{
-	  auto orig_it = m_it;
-	  if (! maybe_next_dwarf (m_cuit, m_it, m_dwarfs.end ()))
+	  if (m_it == m_dwarfs.end ())
 	    return nullptr;
-	  if (m_it != orig_it)
-	    m_seen.clear ();
+	  m_cus = &m_dwctx->get_abbrev_cache ().get (*m_it++);
+	  m_j = 0;
 	}
-      while ([this] ()
-	     {
-	       Dwarf_Off off = dwpp_cu_abbrev_unit_offset (*(*m_cuit)->cu);
-	       bool isnew = std::find (m_seen.begin (), m_seen.end (),
-				       off) == m_seen.end ();
-	       if (isnew)
-		 m_seen.push_back (off);
-	       else
-		 ++m_cuit;
-	       return ! isnew;
-	     } ());
 
       return std::make_unique <value_abbrev_unit>
-	(m_dwctx, *(*m_cuit++)->cu, m_i++);
+	(m_dwctx, *(*m_cus)[m_j++], m_i++);
     }
   };
 }
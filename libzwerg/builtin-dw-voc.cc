@@ -71,7 +71,7 @@ dwgrep_vocabulary_dw ()
     t->add_op_overload <op_unit_attr> ();
     // xxx rawattr
 
-    voc.add (std::make_shared <overloaded_op_builtin> ("unit", t));
+    voc.add (std::make_shared <unit_builtin> ("unit", t));
   }
 
   {
@@ -81,7 +81,7 @@ dwgrep_vocabulary_dw ()
     t->add_op_overload <op_entry_cu> ();
     t->add_op_overload <op_entry_abbrev_unit> ();
 
-    voc.add (std::make_shared <overloaded_op_builtin> ("entry", t));
+    voc.add (std::make_shared <entry_builtin> ("entry", t));
   }
 
   {
@@ -116,7 +116,7 @@ dwgrep_vocabulary_dw ()
 
     t->add_op_overload <op_child_die> ();
 
-    voc.add (std::make_shared <overloaded_op_builtin> ("child", t));
+    voc.add (std::make_shared <child_builtin> ("child", t));
   }
 
   {
@@ -172,6 +172,14 @@ dwgrep_vocabulary_dw ()
     voc.add (std::make_shared <overloaded_op_builtin> ("address", t));
   }
 
+  {
+    auto t = std::make_shared <overload_tab> ();
+
+    t->add_op_overload <op_addrdie_dwarf_cst> ();
+
+    voc.add (std::make_shared <overloaded_op_builtin> ("addrdie", t));
+  }
+
   {
     auto t = std::make_shared <overload_tab> ();
 
@@ -378,7 +386,7 @@ dwgrep_vocabulary_dw ()
 
     t->add_op_overload <op_symbol_dwarf> ();
 
-    voc.add (std::make_shared <overloaded_op_builtin> ("symbol", t));
+    voc.add (std::make_shared <symbol_builtin> ("symbol", t));
   }
 
   {
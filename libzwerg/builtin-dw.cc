@@ -27,17 +27,20 @@
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
 
+#include <cstring>
 #include <memory>
 #include <sstream>
 
 #include "atval.hh"
 #include "builtin-dw.hh"
+#include "cache.hh"
 #include "dwcst.hh"
 #include "dwit.hh"
 #include "dwmods.hh"
 #include "dwpp.hh"
 #include "op.hh"
 #include "overload.hh"
+#include "tree.hh"
 #include "value-cst.hh"
 #include "value-str.hh"
 #include "value-dw.hh"
@@ -82,6 +85,8 @@ namespace
     return false;
   }
 
+  // Units whose offset doesn't pass M_FILTER (if any) are skipped,
+  // but still counted.
   struct dwarf_unit_producer
     : public value_producer <value_cu>
   {
@@ -91,29 +96,38 @@ namespace
     cu_iterator m_cuit;
     size_t m_i;
     doneness m_doneness;
+    die_filter const *m_filter;
 
-    dwarf_unit_producer (std::shared_ptr <dwfl_context> dwctx, doneness d)
+    dwarf_unit_producer (std::shared_ptr <dwfl_context> dwctx, doneness d,
+			 die_filter const *filter = nullptr)
       : m_dwctx {dwctx}
       , m_dwarfs {all_dwarfs (*dwctx)}
       , m_it {m_dwarfs.begin ()}
       , m_cuit {cu_iterator::end ()}
       , m_i {0}
       , m_doneness {d}
+      , m_filter {filter}
     {}
 
     std::unique_ptr <value_cu>
     next () override
     {
-      do
-	if (! maybe_next_dwarf (m_cuit, m_it, m_dwarfs.end ()))
-	  return nullptr;
-      while (! next_acceptable_unit (m_doneness, m_cuit));
+      while (true)
+	{
+	  do
+	    if (! maybe_next_dwarf (m_cuit, m_it, m_dwarfs.end ()))
+	      return nullptr;
+	  while (! next_acceptable_unit (m_doneness, m_cuit));
 
-      Dwarf_CU &cu = *(*m_cuit)->cu;
-      Dwarf_Off off = m_cuit.offset ();
-      ++m_cuit;
+	  Dwarf_CU &cu = *(*m_cuit)->cu;
+	  Dwarf_Off off = m_cuit.offset ();
+	  ++m_cuit;
 
-      return std::make_unique <value_cu> (m_dwctx, cu, off, m_i++, m_doneness);
+	  size_t pos = m_i++;
+	  if (m_filter == nullptr || m_filter->passes_offset (off))
+	    return std::make_unique <value_cu> (m_dwctx, cu, off, pos,
+						m_doneness);
+	}
     }
   };
 }
@@ -121,8 +135,20 @@ namespace
 std::unique_ptr <value_producer <value_cu>>
 op_unit_dwarf::operate (std::unique_ptr <value_dwarf> a) const
 {
-  return std::make_unique <dwarf_unit_producer> (a->get_dwctx (),
-						 a->get_doneness ());
+  return std::make_unique <dwarf_unit_producer>
+    (a->get_dwctx (), a->get_doneness (),
+     m_filter.m_offsets.empty () ? nullptr : &m_filter);
+}
+
+bool
+unit_builtin::add_filtered_overload (overload_tab &t, selector const &sel,
+				     die_filter const &filter,
+				     bool keep_pos) const
+{
+  if (sel != op_unit_dwarf::get_selector () || filter.m_offsets.empty ())
+    return false;
+  t.add_op_overload <op_unit_dwarf> (filter);
+  return true;
 }
 
 std::string
@@ -253,9 +279,62 @@ namespace
     return std::make_pair (a, child_iterator::end ());
   }
 
+  // Records into parent cache of DWCTX parents of DIE's that a
+  // die_it_producer walks through.  PUSH is called with the DIE whose
+  // descendants a newly pushed range covers, RECORD with an iterator
+  // before it's bumped, and POP when a range is exhausted.
+  template <class It>
+  struct parent_recorder;
+
+  // Ranges of all_dies_iterator cover whole units, so once a range is
+  // exhausted, parents of all its DIE's are known.  Units whose
+  // parents the cache has already are not recorded again, their
+  // entries in M_UNITS are nullptr.
+  template <>
+  struct parent_recorder <all_dies_iterator>
+  {
+    std::vector <std::unique_ptr <parent_cache::unit_parents>> m_units;
+
+    void
+    push (dwfl_context &dwctx, Dwarf_Die cudie)
+    {
+      if (dwctx.get_parent_cache ().has_unit (cudie.cu))
+	m_units.push_back (nullptr);
+      else
+	m_units.push_back
+	  (std::make_unique <parent_cache::unit_parents> (cudie));
+    }
+
+    void
+    record (dwfl_context &dwctx, all_dies_iterator &it)
+    {
+      if (m_units.back () != nullptr)
+	m_units.back ()->add (dwarf_dieoffset (*it), it.parent_offset ());
+    }
+
+    void
+    pop (dwfl_context &dwctx)
+    {
+      if (m_units.back () != nullptr)
+	dwctx.get_parent_cache ().add_unit (std::move (*m_units.back ()));
+      m_units.pop_back ();
+    }
+  };
+
+  // Children of a DIE are only a part of their unit, and the cache
+  // only keeps tables of whole units, so nothing is recorded.
+  template <>
+  struct parent_recorder <child_iterator>
+  {
+    void push (dwfl_context &dwctx, Dwarf_Die parent) {}
+    void record (dwfl_context &dwctx, child_iterator &it) {}
+    void pop (dwfl_context &dwctx) {}
+  };
+
   template <class It>
   bool
   import_partial_units (std::vector <std::pair <It, It>> &stack,
+			parent_recorder <It> &rec,
 			std::shared_ptr <dwfl_context> dwctx,
 			std::shared_ptr <value_die> &import)
   {
@@ -273,10 +352,12 @@ namespace
 					       doneness::cooked);
 
 	// Skip DW_TAG_imported_unit.
+	rec.record (*dwctx, stack.back ().first);
 	stack.back ().first++;
 
 	// `true` to skip root DIE of DW_TAG_partial_unit.
 	stack.push_back (get_it_range <It> (cudie, true));
+	rec.push (*dwctx, cudie);
 	return true;
       }
 
@@ -286,6 +367,7 @@ namespace
   template <class It>
   bool
   drop_finished_imports (std::vector <std::pair <It, It>> &stack,
+			 parent_recorder <It> &rec, dwfl_context &dwctx,
 			 std::shared_ptr <value_die> &import)
   {
     assert (! stack.empty ());
@@ -293,6 +375,7 @@ namespace
       return false;
 
     stack.pop_back ();
+    rec.pop (dwctx);
 
     // We have one more item in STACK than values in IMPORT chain, so
     // this can actually be empty at this point.
@@ -302,54 +385,333 @@ namespace
     return true;
   }
 
-  // This producer encapsulates the logic for iteration through a
-  // range of DIE's, with optional inlining of partial units along the
-  // way.  Cooked producers do inline, raw ones don't.
-  template <class It>
-  struct die_it_producer
+  // Base class for producers of DIE's.  M_I counts DIE's that the
+  // producer went through, including those that it skipped, and
+  // serves for numbering yielded DIE's.
+  struct die_producer
     : public value_producer <value_die>
   {
     std::shared_ptr <dwfl_context> m_dwctx;
 
-    // Stack of iterator ranges.
-    std::vector <std::pair <It, It>> m_stack;
-
     // Chain of DIE's where partial units were imported.
     std::shared_ptr <value_die> m_import;
 
     size_t m_i;
     doneness m_doneness;
 
-    die_it_producer (std::shared_ptr <dwfl_context> dwctx, Dwarf_Die die,
-		     doneness d)
+    die_producer (std::shared_ptr <dwfl_context> dwctx, doneness d)
       : m_dwctx {dwctx}
       , m_i {0}
       , m_doneness {d}
+    {}
+  };
+
+  // This producer encapsulates the logic for iteration through a
+  // range of DIE's, with optional inlining of partial units along the
+  // way.  Cooked producers do inline, raw ones don't.
+  //
+  // DIE's that certainly don't pass M_FILTER (if any) are skipped
+  // before a value_die is constructed for them.
+  template <class It>
+  struct die_it_producer
+    : public die_producer
+  {
+    // Stack of iterator ranges.
+    std::vector <std::pair <It, It>> m_stack;
+    parent_recorder <It> m_rec;
+
+    die_filter const *m_filter;
+
+    die_it_producer (std::shared_ptr <dwfl_context> dwctx, Dwarf_Die die,
+		     doneness d)
+      : die_producer {dwctx, d}
+      , m_filter {nullptr}
     {
       m_stack.push_back (get_it_range <It> (die, false));
+      m_rec.push (*dwctx, die);
+    }
+
+    die_it_producer (std::shared_ptr <dwfl_context> dwctx, Dwarf_Die die,
+		     doneness d, die_filter const &filter)
+      : die_it_producer {dwctx, die, d}
+    {
+      if (! filter.empty ())
+	m_filter = &filter;
     }
 
     std::unique_ptr <value_die>
     next () override
     {
-      do
-	if (m_stack.empty ())
-	  return nullptr;
-      while (drop_finished_imports (m_stack, m_import)
-	     || (m_doneness == doneness::cooked
-		 && import_partial_units (m_stack, m_dwctx, m_import)));
+      while (true)
+	{
+	  do
+	    if (m_stack.empty ())
+	      return nullptr;
+	  while (drop_finished_imports (m_stack, m_rec, *m_dwctx, m_import)
+		 || (m_doneness == doneness::cooked
+		     && import_partial_units (m_stack, m_rec,
+					      m_dwctx, m_import)));
+
+	  m_rec.record (*m_dwctx, m_stack.back ().first);
+	  Dwarf_Die die = **m_stack.back ().first++;
+	  size_t pos = m_i++;
+	  if (m_filter == nullptr
+	      || m_filter->may_pass (die, m_doneness == doneness::cooked))
+	    return std::make_unique <value_die>
+	      (m_dwctx, m_import, die, pos, m_doneness);
+	}
+    }
+  };
+
+  // Like die_it_producer <all_dies_iterator>, but walks rows of a DIE
+  // index instead of decoding .debug_info.  Only DIE's that may pass
+  // M_FILTER are actually produced.
+  struct die_index_producer
+    : public die_producer
+  {
+    die_index const &m_index;
+    die_filter const &m_filter;
+
+    // A unit in a DIE index table.  M_ROOT is the row of the unit
+    // DIE, M_ROW the next row to visit.
+    struct unit_rows
+    {
+      die_index::table const *m_tab;
+      size_t m_root;
+      size_t m_row;
+
+      bool
+      done () const
+      {
+	return m_row == m_tab->size ()
+	  || (m_row != m_root && m_tab->parent (m_row) == die_index::no_off);
+      }
+    };
+
+    // Stack of units, the bottom one is the unit that we walk, the
+    // others are imported partial units.
+    std::vector <unit_rows> m_stack;
+
+    die_index_producer (std::shared_ptr <dwfl_context> dwctx,
+			die_index const &index, die_index::table const &tab,
+			size_t root, die_filter const &filter, doneness d)
+      : die_producer {dwctx, d}
+      , m_index {index}
+      , m_filter {filter}
+    {
+      m_stack.push_back ({&tab, root, root});
+    }
+
+    static Dwarf_Die
+    offdie (die_index::table const &tab, size_t row)
+    {
+      Dwarf_Die die;
+      if (dwarf_offdie (tab.get_dwarf (), tab.offset (row), &die) == nullptr)
+	throw_libdw ();
+      return die;
+    }
+
+    // Mirrors import_partial_units.  Return true if the partial unit
+    // at DIE was imported.
+    bool
+    import_partial_unit (Dwarf_Die die)
+    {
+      Dwarf_Attribute at_import;
+      Dwarf_Die cudie;
+      if (! dwarf_hasattr (&die, DW_AT_import)
+	  || dwarf_attr (&die, DW_AT_import, &at_import) == nullptr
+	  || dwarf_formref_die (&at_import, &cudie) == nullptr)
+	return false;
+
+      auto tab = m_index.find_table (dwarf_cu_getdwarf (cudie.cu));
+      size_t root = tab != nullptr ? tab->find (dwarf_dieoffset (&cudie)) : 0;
+      if (tab == nullptr || root == tab->size ())
+	throw std::runtime_error ("DIE index doesn't cover imported unit");
+
+      m_import = std::make_shared <value_die> (m_dwctx, m_import, die, 0,
+					       doneness::cooked);
 
-      return std::make_unique <value_die>
-	(m_dwctx, m_import, **m_stack.back ().first++, m_i++, m_doneness);
+      // Skip root DIE of DW_TAG_partial_unit.
+      m_stack.push_back ({tab, root, root + 1});
+      return true;
+    }
+
+    std::unique_ptr <value_die>
+    next () override
+    {
+      while (! m_stack.empty ())
+	{
+	  unit_rows &ur = m_stack.back ();
+	  if (ur.done ())
+	    {
+	      // Mirrors drop_finished_imports.
+	      m_stack.pop_back ();
+	      if (m_import != nullptr)
+		m_import = m_import->get_import ();
+	      continue;
+	    }
+
+	  die_index::table const &tab = *ur.m_tab;
+	  size_t row = ur.m_row++;
+	  if (m_doneness == doneness::cooked
+	      && tab.tag (row) == DW_TAG_imported_unit
+	      && import_partial_unit (offdie (tab, row)))
+	    continue;
+
+	  size_t pos = m_i++;
+	  if (tab.may_pass (row, m_filter, m_doneness == doneness::cooked))
+	    return std::make_unique <value_die>
+	      (m_dwctx, m_import, offdie (tab, row), pos, m_doneness);
+	}
+
+      return nullptr;
     }
   };
 
-  std::unique_ptr <value_producer <value_die>>
-  make_cu_entry_producer (std::shared_ptr <dwfl_context> dwctx, Dwarf_CU &cu,
-			  doneness d)
+  // Produce DIE's of a unit whose root DIE is CUDIE.  DIE's that
+  // certainly don't pass FILTER may be skipped.
+  std::unique_ptr <die_producer>
+  make_unit_entry_producer (std::shared_ptr <dwfl_context> dwctx,
+			    Dwarf_Die cudie, doneness d,
+			    die_filter const &filter)
   {
+    if (! filter.empty ())
+      if (die_index const *index = dwctx->get_die_index ())
+	if (auto tab = index->find_table (dwarf_cu_getdwarf (cudie.cu)))
+	  {
+	    size_t root = tab->find (dwarf_dieoffset (&cudie));
+	    if (root != tab->size ())
+	      return std::make_unique <die_index_producer>
+		(dwctx, *index, *tab, root, filter, d);
+	  }
+
     return std::make_unique <die_it_producer <all_dies_iterator>>
-      (dwctx, dwpp_cudie (cu), d);
+      (dwctx, cudie, d, filter);
+  }
+
+  // Find DIE at offset OFF in DW, and the root DIE of its unit.
+  // Return false if there's no DIE at OFF.
+  //
+  // Finding the unit is a binary search in libdw.  OFF might point
+  // into the middle of a DIE though, so the DIE itself is looked up by
+  // descending from the unit DIE, skipping subtrees that end before
+  // OFF.  Unless the DIE's have DW_AT_sibling, skipping a subtree
+  // means walking it, but that is still confined to one unit.
+  bool
+  find_die (die_index const *index, Dwarf *dw, Dwarf_Off off,
+	    Dwarf_Die &ret, Dwarf_Die &cudie)
+  {
+    if (auto tab = index != nullptr ? index->find_table (dw) : nullptr)
+      {
+	if (tab->find (off) == tab->size ()
+	    || dwarf_offdie (dw, off, &ret) == nullptr)
+	  return false;
+	cudie = dwpp_cudie (ret);
+	return true;
+      }
+
+    // For an offset that's not in any unit, or that doesn't decode as
+    // a DIE, dwarf_offdie fails.
+    Dwarf_Die die;
+    if (dwarf_offdie (dw, off, &die) == nullptr)
+      return false;
+
+    cudie = dwpp_cudie (die);
+    if (dwarf_dieoffset (&cudie) == off)
+      {
+	ret = cudie;
+	return true;
+      }
+
+    Dwarf_Die cur;
+    int rc = dwarf_child (&cudie, &cur);
+    while (rc == 0 && dwarf_dieoffset (&cur) <= off)
+      {
+	if (dwarf_dieoffset (&cur) == off)
+	  {
+	    ret = cur;
+	    return true;
+	  }
+
+	Dwarf_Die next;
+	rc = dwarf_siblingof (&cur, &next);
+	if (rc == 0 && dwarf_dieoffset (&next) <= off)
+	  {
+	    cur = next;
+	    continue;
+	  }
+	if (rc < 0)
+	  break;
+
+	// If the DIE is anywhere, it's among descendants of CUR.
+	rc = dwarf_child (&cur, &next);
+	cur = next;
+      }
+
+    if (rc < 0)
+      throw_libdw ();
+    return false;
+  }
+
+  struct die_vector_producer
+    : public die_producer
+  {
+    std::vector <Dwarf_Die> m_dies;
+
+    die_vector_producer (std::shared_ptr <dwfl_context> dwctx,
+			 std::vector <Dwarf_Die> dies, doneness d)
+      : die_producer {dwctx, d}
+      , m_dies {std::move (dies)}
+    {}
+
+    std::unique_ptr <value_die>
+    next () override
+    {
+      if (m_i == m_dies.size ())
+	return nullptr;
+
+      size_t pos = m_i++;
+      return std::make_unique <value_die> (m_dwctx, m_dies[pos], pos,
+					   m_doneness);
+    }
+  };
+
+  // For FILTER that requires an offset, produce the DIE's that entry
+  // would yield, by looking the offset up directly.  With CUDIE, only
+  // consider DIE's of that unit, otherwise those of all units.
+  //
+  // In cooked mode, DIE's of partial units are yielded once for each
+  // place where the unit is imported, and imported_unit DIE's are
+  // replaced with what they import.  Finding that out takes a walk
+  // through the DIE's, so this returns nullptr if the DIE at the
+  // offset is like that.
+  std::unique_ptr <die_producer>
+  make_offset_lookup_producer (std::shared_ptr <dwfl_context> dwctx,
+			       Dwarf_Die const *cudie, doneness d,
+			       die_filter const &filter)
+  {
+    assert (! filter.m_offsets.empty ());
+    Dwarf_Off off = filter.m_offsets.front ();
+    die_index const *index = dwctx->loaded_die_index ();
+    bool cooked = d == doneness::cooked;
+
+    std::vector <Dwarf_Die> dies;
+    for (Dwarf *dw: all_dwarfs (*dwctx))
+      {
+	Dwarf_Die die, unit;
+	if (! find_die (index, dw, off, die, unit))
+	  continue;
+
+	if (cooked && (dwarf_tag (&unit) == DW_TAG_partial_unit
+		       || dwarf_tag (&die) == DW_TAG_imported_unit))
+	  return nullptr;
+
+	if ((cudie == nullptr || unit.cu == cudie->cu)
+	    && filter.may_pass (die, cooked))
+	  dies.push_back (die);
+      }
+
+    return std::make_unique <die_vector_producer> (dwctx, dies, d);
   }
 }
 
@@ -357,8 +719,14 @@ namespace
 std::unique_ptr <value_producer <value_die>>
 op_entry_cu::operate (std::unique_ptr <value_cu> a) const
 {
-  return make_cu_entry_producer (a->get_dwctx (), a->get_cu (),
-				 a->get_doneness ());
+  Dwarf_Die cudie = dwpp_cudie (a->get_cu ());
+  if (! m_keep_pos && ! m_filter.m_offsets.empty ())
+    if (auto prod = make_offset_lookup_producer (a->get_dwctx (), &cudie,
+						 a->get_doneness (), m_filter))
+      return std::move (prod);
+
+  return make_unit_entry_producer (a->get_dwctx (), cudie,
+				   a->get_doneness (), m_filter);
 }
 
 std::string
@@ -405,11 +773,16 @@ namespace
     : public value_producer <value_die>
   {
     dwarf_unit_producer m_unitprod;
-    std::unique_ptr <die_it_producer <all_dies_iterator>> m_dieprod;
+    std::unique_ptr <die_producer> m_dieprod;
+    die_filter const &m_filter;
+
+    // Number of DIE's in units that were already walked through.
     size_t m_i;
 
-    dwarf_entry_producer (std::shared_ptr <dwfl_context> dwctx, doneness d)
+    dwarf_entry_producer (std::shared_ptr <dwfl_context> dwctx, doneness d,
+			  die_filter const &filter)
       : m_unitprod {dwctx, d}
+      , m_filter {filter}
       , m_i {0}
     {}
 
@@ -420,18 +793,19 @@ namespace
 	{
 	  while (m_dieprod == nullptr)
 	    if (auto cu = m_unitprod.next ())
-	      m_dieprod = std::make_unique <die_it_producer <all_dies_iterator>>
+	      m_dieprod = make_unit_entry_producer
 				(m_unitprod.m_dwctx, dwpp_cudie (cu->get_cu ()),
-				 m_unitprod.m_doneness);
+				 m_unitprod.m_doneness, m_filter);
 	    else
 	      return nullptr;
 
 	  if (auto ret = m_dieprod->next ())
 	    {
-	      ret->set_pos (m_i++);
+	      ret->set_pos (m_i + ret->get_pos ());
 	      return ret;
 	    }
 
+	  m_i += m_dieprod->m_i;
 	  m_dieprod = nullptr;
 	}
     }
@@ -441,8 +815,14 @@ namespace
 std::unique_ptr <value_producer <value_die>>
 op_entry_dwarf::operate (std::unique_ptr <value_dwarf> a) const
 {
+  if (! m_keep_pos && ! m_filter.m_offsets.empty ())
+    if (auto prod = make_offset_lookup_producer (a->get_dwctx (), nullptr,
+						 a->get_doneness (), m_filter))
+      return std::move (prod);
+
   return std::make_unique <dwarf_entry_producer> (a->get_dwctx (),
-						  a->get_doneness ());
+						  a->get_doneness (),
+						  m_filter);
 }
 
 std::string
@@ -460,24 +840,170 @@ behaves equivalently to the following::
 }
 
 
+namespace
+{
+  // Return whether the assertion RP is `name == "STR"' or `"STR" ==
+  // name', and if it is, store STR to RET.
+  bool
+  match_name_eq (reducible_pred const &rp, std::string &ret)
+  {
+    tree const *t = match_word_eq (rp, "name");
+    if (t == nullptr || t->tt () != tree_type::STR)
+      return false;
+
+    ret = t->str ();
+    return true;
+  }
+
+  // Return whether the assertion RP is `offset == K' or `K ==
+  // offset', where K is an integer literal, and if it is, store K to
+  // RET.
+  bool
+  match_offset_eq (reducible_pred const &rp, Dwarf_Off &ret)
+  {
+    tree const *t = match_word_eq (rp, "offset");
+    if (t == nullptr || t->tt () != tree_type::CONST)
+      return false;
+
+    // Only arithmetic constants compare equal to offsets.
+    constant const &cst = t->cst ();
+    if (cst.dom () == nullptr || ! cst.dom ()->safe_arith ()
+	|| cst.value () < 0)
+      return false;
+
+    ret = cst.value ().uval ();
+    return true;
+  }
+
+  // Return the pred that overloaded predicate word BI uses for DIE's,
+  // and set POSITIVE according to whether BI inverts it.
+  std::unique_ptr <pred>
+  die_pred (builtin const &bi, layout &l, bool &positive)
+  {
+    auto obi = dynamic_cast <overloaded_pred_builtin const *> (&bi);
+    if (obi == nullptr)
+      return nullptr;
+
+    positive = obi->m_positive;
+    selector sel {value_die::vtype};
+    for (auto const &ovl: obi->get_overload_tab ()->get_overloads ())
+      if (std::get <0> (ovl) == sel)
+	return std::get <1> (ovl)->build_pred (l);
+
+    return nullptr;
+  }
+
+  // Derive a filter for DIE's from PREDS.  Only the leading preds that
+  // are understood are considered.  Later preds may not even be
+  // applicable to DIE's, and skipping DIE's that wouldn't get to them
+  // anyway could hide such errors.
+  die_filter
+  filter_for_preds (std::vector <reducible_pred> const &preds, layout &l)
+  {
+    die_filter ret;
+    for (auto const &rp: preds)
+      {
+	std::string name;
+	Dwarf_Off off;
+	if (rp.m_builtin == nullptr)
+	  {
+	    if (match_name_eq (rp, name))
+	      ret.add_name (name);
+	    else if (match_offset_eq (rp, off))
+	      ret.m_offsets.push_back (off);
+	    else
+	      break;
+	    continue;
+	  }
+
+	bool positive;
+	auto pred = die_pred (*rp.m_builtin, l, positive);
+	if (auto p = dynamic_cast <pred_tag_die const *> (pred.get ()))
+	  ret.m_tags.push_back (std::make_pair (p->get_tag (), positive));
+	else if (auto p = dynamic_cast <pred_atname_die const *> (pred.get ()))
+	  ret.m_atnames.push_back (std::make_pair (p->get_atname (), positive));
+	else
+	  break;
+      }
+
+    return ret;
+  }
+}
+
+std::shared_ptr <op>
+die_filter_builtin::build_reduced (layout &l, std::shared_ptr <op> upstream,
+				   std::vector <reducible_pred> &preds,
+				   bool keep_pos) const
+{
+  die_filter filter = filter_for_preds (preds, l);
+  if (filter.empty ())
+    return nullptr;
+
+  // Swap the DIE-producing overloads for ones that know the filter.
+  auto t = std::make_shared <overload_tab> ();
+  for (auto const &ovl: get_overload_tab ()->get_overloads ())
+    if (! add_filtered_overload (*t, std::get <0> (ovl), filter, keep_pos))
+      t->add_overload (std::get <0> (ovl), std::get <1> (ovl));
+
+  auto op = overloaded_op_builtin {name (), t}.build_exec (l, upstream);
+  for (auto &rp: preds)
+    op = std::make_shared <op_assert> (op, std::move (rp.m_pred));
+  return op;
+}
+
+bool
+entry_builtin::add_filtered_overload (overload_tab &t, selector const &sel,
+				      die_filter const &filter,
+				      bool keep_pos) const
+{
+  if (sel == op_entry_dwarf::get_selector ())
+    t.add_op_overload <op_entry_dwarf> (filter, keep_pos);
+  else if (sel == op_entry_cu::get_selector ())
+    t.add_op_overload <op_entry_cu> (filter, keep_pos);
+  else
+    return false;
+  return true;
+}
+
+
 // child
 namespace
 {
   std::unique_ptr <value_producer <value_die>>
   make_die_child_producer (std::shared_ptr <dwfl_context> dwctx,
-			   Dwarf_Die parent, doneness d)
+			   Dwarf_Die parent, doneness d,
+			   die_filter const &filter)
   {
     return std::make_unique <die_it_producer <child_iterator>>
-      (dwctx, parent, d);
+      (dwctx, parent, d, filter);
   }
 }
 
+bool
+child_builtin::add_filtered_overload (overload_tab &t, selector const &sel,
+				      die_filter const &filter,
+				      bool keep_pos) const
+{
+  if (sel != op_child_die::get_selector ())
+    return false;
+  t.add_op_overload <op_child_die> (filter);
+  return true;
+}
 
 std::unique_ptr <value_producer <value_die>>
 op_child_die::operate (std::unique_ptr <value_die> a) const
 {
   return make_die_child_producer (a->get_dwctx (), a->get_die (),
-				  a->get_doneness ());
+				  a->get_doneness (), m_filter);
+}
+
+// Raw DIE's form a tree, so there's only one way to reach each of
+// them.  Cooked children may come from a partial unit imported
+// several times.
+bool
+op_child_die::acyclic (stack &stk) const
+{
+  return stk.top_as <value_die> ()->is_raw ();
 }
 
 std::string
@@ -573,10 +1099,25 @@ Takes a location expression on TOS and yields individual operators::
 )docstring";
 }
 
+std::unique_ptr <value_producer <value_loclist_op>>
+make_elem_loclist_producer (std::unique_ptr <value_loclist_elem> elem,
+			    bool forward)
+{
+  return std::make_unique <elem_loclist_producer> (std::move (elem), forward);
+}
+
 std::unique_ptr <value_producer <value_loclist_op>>
 op_elem_loclist_elem::operate (std::unique_ptr <value_loclist_elem> a) const
 {
-  return std::make_unique <elem_loclist_producer> (std::move (a), true);
+  return make_elem_loclist_producer (std::move (a), true);
+}
+
+// Operations of a location expression are at distinct offsets, and
+// no elem applies to them.
+bool
+op_elem_loclist_elem::acyclic (stack &stk) const
+{
+  return true;
 }
 
 std::string
@@ -588,7 +1129,13 @@ op_elem_loclist_elem::docstring ()
 std::unique_ptr <value_producer <value_loclist_op>>
 op_relem_loclist_elem::operate (std::unique_ptr <value_loclist_elem> a) const
 {
-  return std::make_unique <elem_loclist_producer> (std::move (a), false);
+  return make_elem_loclist_producer (std::move (a), false);
+}
+
+bool
+op_relem_loclist_elem::acyclic (stack &stk) const
+{
+  return true;
 }
 
 std::string
@@ -714,10 +1261,16 @@ namespace
   };
 }
 
+std::unique_ptr <value_producer <value_attr>>
+make_attribute_producer (std::unique_ptr <value_die> die)
+{
+  return std::make_unique <attribute_producer> (std::move (die));
+}
+
 std::unique_ptr <value_producer <value_attr>>
 op_attribute_die::operate (std::unique_ptr <value_die> a) const
 {
-  return std::make_unique <attribute_producer> (std::move (a));
+  return make_attribute_producer (std::move (a));
 }
 
 std::string
@@ -920,6 +1473,55 @@ covered by this DIE.  (This calls dwarf_ranges under the covers.)::
 )docstring";
 }
 
+
+// addrdie
+
+std::unique_ptr <value_producer <value_die>>
+op_addrdie_dwarf_cst::operate (std::unique_ptr <value_dwarf> a,
+			       std::unique_ptr <value_cst> b) const
+{
+  std::vector <Dwarf_Die> dies;
+  constant const &cst = b->get_constant ();
+  if (cst.value () >= 0)
+    {
+      auto dwctx = a->get_dwctx ();
+      for (Dwarf *dw: all_dwarfs (*dwctx))
+	for (Dwarf_Off off: dwctx->get_addr_cache ()
+					.find (dw, cst.value ().uval ()))
+	  {
+	    Dwarf_Die die;
+	    if (dwarf_offdie (dw, off, &die) == nullptr)
+	      throw_libdw ();
+	    dies.push_back (die);
+	  }
+    }
+
+  return std::make_unique <die_vector_producer>
+    (a->get_dwctx (), std::move (dies), a->get_doneness ());
+}
+
+std::string
+op_addrdie_dwarf_cst::docstring ()
+{
+  return
+R"docstring(
+
+Takes a Dwarf and an address on TOS, and yields DIE's whose address
+ranges contain that address, in the order in which they appear in the
+Dwarf.  It yields the same DIE's as ``entry ?(address ADDR ?contains)``
+would, but looks them up in an index instead of decoding each DIE's
+ranges.  The index is built on first use and kept with the Dwarf, so
+resolving many addresses against one file is cheap::
+
+	$ dwgrep ./tests/testfile_const_type -e '0x80482f1 addrdie ?TAG_subprogram name'
+	main
+
+Cooked DIE's are yielded as if looked up by offset, i.e. without
+a path of imported partial units that leads to them.
+
+)docstring";
+}
+
 namespace
 {
   std::unique_ptr <value_cst>
@@ -1146,6 +1748,12 @@ op_parent_die::operate (std::unique_ptr <value_die> a) const
   return a->get_parent ();
 }
 
+bool
+op_parent_die::acyclic (stack &stk) const
+{
+  return stk.top_as <value_die> ()->is_raw ();
+}
+
 std::string
 op_parent_die::docstring ()
 {
@@ -32,6 +32,7 @@
 
 #include <memory>
 
+#include "die_index.hh"
 #include "overload.hh"
 #include "value-dw.hh"
 #include "value-str.hh"
@@ -40,6 +41,16 @@
 struct vocabulary;
 std::unique_ptr <vocabulary> dwgrep_vocabulary_dw ();
 
+// Yield attributes of DIE, like the word "attribute" does.
+std::unique_ptr <value_producer <value_attr>>
+make_attribute_producer (std::unique_ptr <value_die> die);
+
+// Yield operations of location expression ELEM, like the word "elem"
+// does.  If FORWARD is false, yield them backwards, like "relem".
+std::unique_ptr <value_producer <value_loclist_op>>
+make_elem_loclist_producer (std::unique_ptr <value_loclist_elem> elem,
+			    bool forward);
+
 struct op_dwopen_str
   : public op_once_overload <value_dwarf, value_str>
 {
@@ -53,7 +64,15 @@ struct op_dwopen_str
 struct op_unit_dwarf
   : public op_yielding_overload <value_cu, value_dwarf>
 {
-  using op_yielding_overload::op_yielding_overload;
+  // Units whose offset doesn't pass this filter don't need to be
+  // yielded.  Other conditions of the filter are ignored.
+  die_filter m_filter;
+
+  op_unit_dwarf (layout &l, std::shared_ptr <op> upstream,
+		 die_filter filter = {})
+    : op_yielding_overload {l, upstream}
+    , m_filter {filter}
+  {}
 
   std::unique_ptr <value_producer <value_cu>>
   operate (std::unique_ptr <value_dwarf> a) const override;
@@ -81,10 +100,78 @@ struct op_unit_attr
   static std::string docstring ();
 };
 
+// Overloaded builtins that produce DIE's or units look at assertions
+// that follow them, and skip DIE's that certainly wouldn't pass them
+// without producing them.
+struct die_filter_builtin
+  : public overloaded_op_builtin
+{
+  using overloaded_op_builtin::overloaded_op_builtin;
+
+  std::shared_ptr <op>
+  build_reduced (layout &l, std::shared_ptr <op> upstream,
+		 std::vector <reducible_pred> &preds,
+		 bool keep_pos) const override;
+
+protected:
+  // If there is an overload for SEL that knows how to apply FILTER,
+  // add it to T and return true.  KEEP_POS is as in build_reduced.
+  virtual bool add_filtered_overload (overload_tab &t, selector const &sel,
+				      die_filter const &filter,
+				      bool keep_pos) const = 0;
+};
+
+struct unit_builtin
+  : public die_filter_builtin
+{
+  using die_filter_builtin::die_filter_builtin;
+
+protected:
+  bool add_filtered_overload (overload_tab &t, selector const &sel,
+			      die_filter const &filter,
+			      bool keep_pos) const override;
+};
+
+struct entry_builtin
+  : public die_filter_builtin
+{
+  using die_filter_builtin::die_filter_builtin;
+
+protected:
+  bool add_filtered_overload (overload_tab &t, selector const &sel,
+			      die_filter const &filter,
+			      bool keep_pos) const override;
+};
+
+struct child_builtin
+  : public die_filter_builtin
+{
+  using die_filter_builtin::die_filter_builtin;
+
+protected:
+  bool add_filtered_overload (overload_tab &t, selector const &sel,
+			      die_filter const &filter,
+			      bool keep_pos) const override;
+};
+
 struct op_entry_cu
   : public op_yielding_overload <value_die, value_cu>
 {
-  using op_yielding_overload::op_yielding_overload;
+  // DIE's that certainly don't pass this filter don't need to be
+  // yielded.
+  die_filter m_filter;
+
+  // If false, DIE's don't need to be yielded at the positions that
+  // they would be at without the filter.  That allows looking up DIE
+  // at an offset that the filter requires directly.
+  bool m_keep_pos;
+
+  op_entry_cu (layout &l, std::shared_ptr <op> upstream,
+	       die_filter filter = {}, bool keep_pos = true)
+    : op_yielding_overload {l, upstream}
+    , m_filter {filter}
+    , m_keep_pos {keep_pos}
+  {}
 
   std::unique_ptr <value_producer <value_die>>
   operate (std::unique_ptr <value_cu> a) const override;
@@ -95,7 +182,16 @@ struct op_entry_cu
 struct op_entry_dwarf
   : public op_yielding_overload <value_die, value_dwarf>
 {
-  using op_yielding_overload::op_yielding_overload;
+  // See op_entry_cu::m_filter and m_keep_pos.
+  die_filter m_filter;
+  bool m_keep_pos;
+
+  op_entry_dwarf (layout &l, std::shared_ptr <op> upstream,
+		  die_filter filter = {}, bool keep_pos = true)
+    : op_yielding_overload {l, upstream}
+    , m_filter {filter}
+    , m_keep_pos {keep_pos}
+  {}
 
   std::unique_ptr <value_producer <value_die>>
   operate (std::unique_ptr <value_dwarf> a) const override;
@@ -106,11 +202,19 @@ struct op_entry_dwarf
 struct op_child_die
   : public op_yielding_overload <value_die, value_die>
 {
-  using op_yielding_overload::op_yielding_overload;
+  // See op_entry_cu::m_filter.
+  die_filter m_filter;
+
+  op_child_die (layout &l, std::shared_ptr <op> upstream,
+		die_filter filter = {})
+    : op_yielding_overload {l, upstream}
+    , m_filter {filter}
+  {}
 
   std::unique_ptr <value_producer <value_die>>
   operate (std::unique_ptr <value_die> a) const override;
 
+  bool acyclic (stack &stk) const override;
   static std::string docstring ();
 };
 
@@ -122,6 +226,7 @@ struct op_elem_loclist_elem
   std::unique_ptr <value_producer <value_loclist_op>>
   operate (std::unique_ptr <value_loclist_elem> a) const override;
 
+  bool acyclic (stack &stk) const override;
   static std::string docstring ();
 };
 
@@ -133,6 +238,7 @@ struct op_relem_loclist_elem
   std::unique_ptr <value_producer <value_loclist_op>>
   operate (std::unique_ptr <value_loclist_elem> a) const override;
 
+  bool acyclic (stack &stk) const override;
   static std::string docstring ();
 };
 
@@ -183,6 +289,18 @@ struct op_address_die
   static std::string docstring ();
 };
 
+struct op_addrdie_dwarf_cst
+  : public op_yielding_overload <value_die, value_dwarf, value_cst>
+{
+  using op_yielding_overload::op_yielding_overload;
+
+  std::unique_ptr <value_producer <value_die>>
+  operate (std::unique_ptr <value_dwarf> a,
+	   std::unique_ptr <value_cst> b) const override;
+
+  static std::string docstring ();
+};
+
 struct op_address_attr
   : public op_overload <value_cst, value_attr>
 {
@@ -245,6 +363,7 @@ struct op_parent_die
 
   std::unique_ptr <value_die>
   operate (std::unique_ptr <value_die> a) const override;
+  bool acyclic (stack &stk) const override;
   static std::string docstring ();
 };
 
@@ -459,6 +578,7 @@ class pred_atname_die
 
 public:
   pred_atname_die (unsigned atname);
+  unsigned get_atname () const { return m_atname; }
   pred_result result (value_die &a) const override;
   static std::string docstring ();
 };
@@ -492,6 +612,7 @@ class pred_tag_die
 
 public:
   pred_tag_die (int tag);
+  int get_tag () const { return m_tag; }
   pred_result result (value_die &a) const override;
   static std::string docstring ();
 };
@@ -27,6 +27,8 @@
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
 
+#include <algorithm>
+
 #include "builtin-shf.hh"
 #include "op.hh"
 
@@ -82,6 +84,13 @@ op_drop::docstring ()
   return shf_docstring;
 }
 
+void
+op_drop::stack_effect (stack_profile &profile)
+{
+  if (! profile.empty ())
+    profile.pop_back ();
+}
+
 
 stack::uptr
 op_swap::next (scon &sc) const
@@ -109,13 +118,22 @@ op_swap::docstring ()
   return shf_docstring;
 }
 
+void
+op_swap::stack_effect (stack_profile &profile)
+{
+  if (profile.size () >= 2)
+    std::swap (profile[profile.size () - 1], profile[profile.size () - 2]);
+  else
+    profile.clear ();
+}
+
 
 stack::uptr
 op_dup::next (scon &sc) const
 {
   if (auto stk = m_upstream->next (sc))
     {
-      stk->push (stk->top ().clone ());
+      stk->push_shared (0);
       return stk;
     }
   return nullptr;
@@ -133,13 +151,20 @@ op_dup::docstring ()
   return shf_docstring;
 }
 
+void
+op_dup::stack_effect (stack_profile &profile)
+{
+  if (! profile.empty ())
+    profile.push_back (profile.back ());
+}
+
 
 stack::uptr
 op_over::next (scon &sc) const
 {
   if (auto stk = m_upstream->next (sc))
     {
-      stk->push (stk->get (1).clone ());
+      stk->push_shared (1);
       return stk;
     }
   return nullptr;
@@ -157,6 +182,15 @@ op_over::docstring ()
   return shf_docstring;
 }
 
+void
+op_over::stack_effect (stack_profile &profile)
+{
+  if (profile.size () >= 2)
+    profile.push_back (profile[profile.size () - 2]);
+  else
+    profile.clear ();
+}
+
 
 stack::uptr
 op_rot::next (scon &sc) const
@@ -185,3 +219,12 @@ op_rot::docstring ()
 {
   return shf_docstring;
 }
+
+void
+op_rot::stack_effect (stack_profile &profile)
+{
+  if (profile.size () >= 3)
+    std::rotate (profile.end () - 3, profile.end () - 2, profile.end ());
+  else
+    profile.clear ();
+}
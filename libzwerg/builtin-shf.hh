@@ -30,6 +30,7 @@
 #ifndef _BUILTIN_SHF_H_
 #define _BUILTIN_SHF_H_
 
+#include "builtin.hh"
 #include "op.hh"
 
 struct op_drop
@@ -40,6 +41,7 @@ struct op_drop
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 struct op_swap
@@ -50,6 +52,7 @@ struct op_swap
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 struct op_dup
@@ -60,6 +63,7 @@ struct op_dup
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 struct op_over
@@ -70,6 +74,7 @@ struct op_over
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 struct op_rot
@@ -80,6 +85,7 @@ struct op_rot
 
   std::string name () const override final;
   static std::string docstring ();
+  static void stack_effect (stack_profile &profile);
 };
 
 #endif /* _BUILTIN_SHF_H_ */
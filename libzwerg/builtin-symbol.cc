@@ -29,19 +29,22 @@
 
 #include <vector>
 #include "builtin-symbol.hh"
+#include "cache.hh"
 #include "dwit.hh"
 #include "dwcst.hh"
+#include "op.hh"
+#include "tree.hh"
 
 namespace
 {
+  // Yields symbols of all modules, in the order of their indices.
   struct symbol_producer
     : public value_producer <value_symbol>
   {
     std::shared_ptr <dwfl_context> m_dwctx;
     dwfl_module_iterator m_dwit;
-    dwfl_module m_mod;
+    symbol_cache::module_symbols *m_syms;
     unsigned m_symidx;
-    unsigned m_symcount;
     size_t m_i;
     doneness m_doneness;
 
@@ -50,17 +53,12 @@ namespace
     {
       if (m_dwit != dwfl_module_iterator::end ())
 	{
-	  m_mod = *m_dwit++;
-	  int symcount = dwfl_module_getsymtab (m_mod);
-	  if (symcount < 0)
-	    throw_libdwfl ();
-	  m_symcount = static_cast <unsigned> (symcount);
+	  m_syms = &m_dwctx->get_symbol_cache ().get (*m_dwit++);
 	  m_symidx = 0;
 	  return true;
 	}
 
-      m_symcount = -1u;
-      m_symidx = -1u;
+      m_syms = nullptr;
       return false;
     }
 
@@ -74,32 +72,166 @@ namespace
     }
 
     std::unique_ptr <value_symbol>
-    next ()
+    next () override
     {
-      while (m_symidx >= m_symcount)
-	if (! next_module ())
-	  return nullptr;
-
-      GElf_Sym sym;
-      GElf_Addr addr;
-      GElf_Word shndx;
-      Elf *elf;
-      Dwarf_Addr bias;
-      int symidx = m_symidx++;
-      const char *name = dwfl_module_getsym_info (m_mod, symidx, &sym,
-						  &addr, &shndx, &elf, &bias);
-      if (name == nullptr)
-	throw_libdwfl ();
-
-      return std::make_unique <value_symbol> (m_dwctx, sym, name,
+      while (m_syms != nullptr && m_symidx >= m_syms->size ())
+	next_module ();
+      if (m_syms == nullptr)
+	return nullptr;
+
+      unsigned symidx = m_symidx++;
+      auto const &sym = m_syms->at (symidx);
+      return std::make_unique <value_symbol> (m_dwctx, sym.m_sym, sym.m_name,
 					      symidx, m_i++, m_doneness);
     }
   };
+
+  // Yields symbols that may pass a filter, found through the symbol
+  // index.  They are yielded in the same order and at the same
+  // positions as symbol_producer would yield them.
+  struct symbol_lookup_producer
+    : public value_producer <value_symbol>
+  {
+    struct match
+    {
+      symbol_cache::module_symbols *m_syms;
+      unsigned m_symidx;
+      size_t m_pos;
+    };
+
+    std::shared_ptr <dwfl_context> m_dwctx;
+    std::vector <match> m_matches;
+    size_t m_i;
+    doneness m_doneness;
+
+    symbol_lookup_producer (std::shared_ptr <dwfl_context> dwctx,
+			    symbol_filter const &filter, doneness d)
+      : m_dwctx {dwctx}
+      , m_i {0}
+      , m_doneness {d}
+    {
+      size_t base = 0;
+      std::vector <unsigned> found;
+      for (auto it = dwfl_module_iterator {dwctx->get_dwfl ()};
+	   it != dwfl_module_iterator::end (); ++it)
+	{
+	  auto &syms = dwctx->get_symbol_cache ().get (*it);
+
+	  // One condition narrows the candidates enough, the
+	  // assertions check the rest.
+	  found.clear ();
+	  if (! filter.m_names.empty ())
+	    syms.find_name (filter.m_names.front ().c_str (), found);
+	  else
+	    syms.find_address (filter.m_addresses.front (), found);
+
+	  for (unsigned symidx: found)
+	    m_matches.push_back ({&syms, symidx, base + symidx});
+	  base += syms.size ();
+	}
+    }
+
+    std::unique_ptr <value_symbol>
+    next () override
+    {
+      if (m_i == m_matches.size ())
+	return nullptr;
+
+      match const &m = m_matches[m_i++];
+      auto const &sym = m.m_syms->at (m.m_symidx);
+      return std::make_unique <value_symbol> (m_dwctx, sym.m_sym, sym.m_name,
+					      m.m_symidx, m.m_pos,
+					      m_doneness);
+    }
+  };
+
+  // Return whether the assertion RP is `name == "STR"' or `"STR" ==
+  // name', and if it is, store STR to RET.
+  bool
+  match_name_eq (reducible_pred const &rp, std::string &ret)
+  {
+    tree const *t = match_word_eq (rp, "name");
+    if (t == nullptr || t->tt () != tree_type::STR)
+      return false;
+
+    ret = t->str ();
+    return true;
+  }
+
+  // Return whether the assertion RP is `address == K' or `K ==
+  // address', where K is an integer literal, and if it is, store K
+  // to RET.
+  bool
+  match_address_eq (reducible_pred const &rp, GElf_Addr &ret)
+  {
+    tree const *t = match_word_eq (rp, "address");
+    if (t == nullptr || t->tt () != tree_type::CONST)
+      return false;
+
+    // Only arithmetic constants compare equal to addresses.
+    constant const &cst = t->cst ();
+    if (cst.dom () == nullptr || ! cst.dom ()->safe_arith ()
+	|| cst.value () < 0)
+      return false;
+
+    ret = cst.value ().uval ();
+    return true;
+  }
+
+  // Derive a filter for symbols from the leading PREDS that are
+  // understood.  See filter_for_preds in builtin-dw.cc.
+  symbol_filter
+  filter_for_preds (std::vector <reducible_pred> const &preds)
+  {
+    symbol_filter ret;
+    for (auto const &rp: preds)
+      {
+	std::string name;
+	GElf_Addr addr;
+	if (rp.m_builtin != nullptr)
+	  break;
+	else if (match_name_eq (rp, name))
+	  ret.m_names.push_back (name);
+	else if (match_address_eq (rp, addr))
+	  ret.m_addresses.push_back (addr);
+	else
+	  break;
+      }
+
+    return ret;
+  }
+}
+
+std::shared_ptr <op>
+symbol_builtin::build_reduced (layout &l, std::shared_ptr <op> upstream,
+			       std::vector <reducible_pred> &preds,
+			       bool keep_pos) const
+{
+  symbol_filter filter = filter_for_preds (preds);
+  if (filter.empty ())
+    return nullptr;
+
+  auto t = std::make_shared <overload_tab> ();
+  for (auto const &ovl: get_overload_tab ()->get_overloads ())
+    if (std::get <0> (ovl) == op_symbol_dwarf::get_selector ())
+      t->add_op_overload <op_symbol_dwarf> (filter);
+    else
+      t->add_overload (std::get <0> (ovl), std::get <1> (ovl));
+
+  auto op = overloaded_op_builtin {name (), t}.build_exec (l, upstream);
+  for (auto &rp: preds)
+    op = std::make_shared <op_assert> (op, std::move (rp.m_pred));
+  return op;
 }
 
 std::unique_ptr <value_producer <value_symbol>>
 op_symbol_dwarf::operate (std::unique_ptr <value_dwarf> val) const
 {
+  if (! m_filter.empty ())
+    return std::make_unique <symbol_lookup_producer> (val->get_dwctx (),
+						      m_filter,
+						      val->get_doneness ());
+
   return std::make_unique <symbol_producer> (val->get_dwctx (),
 					     val->get_doneness ());
 }
@@ -113,6 +245,11 @@ R"docstring(
 Takes a Dwarf on TOS and yields every symbol found in any of the
 symbol tables in ELF files that hosts the Dwarf data in question.
 
+When ``symbol`` is immediately followed by an assertion such as
+``(name == "main")`` or ``(address == 0x4004b2)``, the symbols are
+looked up in an index instead of being enumerated.  The index is
+built on first use and kept with the Dwarf.
+
 )docstring";
 }
 
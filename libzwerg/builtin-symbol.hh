@@ -27,16 +27,58 @@
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
 
+#include <string>
+#include <vector>
+
+#include "builtin.hh"
 #include "overload.hh"
 #include "value-cst.hh"
 #include "value-dw.hh"
 #include "value-symbol.hh"
 #include "value-str.hh"
 
+// Conditions that a symbol has to meet to be of interest.  Like
+// die_filter, it's derived from assertions that follow `symbol'.
+struct symbol_filter
+{
+  // Values that `name' of the symbol has to be equal to.
+  std::vector <std::string> m_names;
+
+  // Values that `address' of the symbol has to be equal to.
+  std::vector <GElf_Addr> m_addresses;
+
+  bool
+  empty () const
+  {
+    return m_names.empty () && m_addresses.empty ();
+  }
+};
+
+// `symbol' looks at assertions that follow it, and if they ask for a
+// particular name or address, looks the symbols up in an index
+// instead of enumerating all of them.
+struct symbol_builtin
+  : public overloaded_op_builtin
+{
+  using overloaded_op_builtin::overloaded_op_builtin;
+
+  std::shared_ptr <op>
+  build_reduced (layout &l, std::shared_ptr <op> upstream,
+		 std::vector <reducible_pred> &preds,
+		 bool keep_pos) const override;
+};
+
 struct op_symbol_dwarf
   : public op_yielding_overload <value_symbol, value_dwarf>
 {
-  using op_yielding_overload::op_yielding_overload;
+  // Symbols that certainly don't pass this filter are not yielded.
+  symbol_filter m_filter;
+
+  op_symbol_dwarf (layout &l, std::shared_ptr <op> upstream,
+		   symbol_filter filter = {})
+    : op_yielding_overload {l, upstream}
+    , m_filter {filter}
+  {}
 
   std::unique_ptr <value_producer <value_symbol>>
   operate (std::unique_ptr <value_dwarf> val) const override;
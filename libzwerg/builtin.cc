@@ -27,14 +27,17 @@
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
 
+#include <algorithm>
 #include <memory>
 #include <map>
 #include <set>
+#include <cstring>
 
 #include "builtin.hh"
 #include "builtin-cst.hh"
 #include "op.hh"
 #include "overload.hh"
+#include "tree.hh"
 #include "value-cst.hh"
 
 std::unique_ptr <pred>
@@ -49,6 +52,14 @@ builtin::build_exec (layout &l, std::shared_ptr <op> upstream) const
   return nullptr;
 }
 
+std::shared_ptr <op>
+builtin::build_reduced (layout &l, std::shared_ptr <op> upstream,
+			std::vector <reducible_pred> &preds,
+			bool keep_pos) const
+{
+  return nullptr;
+}
+
 std::string
 builtin::docstring () const
 {
@@ -61,6 +72,51 @@ builtin::protomap () const
   return {};
 }
 
+std::shared_ptr <builtin const>
+builtin::peg (stack_profile const &profile) const
+{
+  return nullptr;
+}
+
+void
+builtin::stack_effect (stack_profile &profile) const
+{
+  auto pm = protomap ();
+  if (pm.size () == 1)
+    apply_prototype (profile, pm[0]);
+  else
+    profile.clear ();
+}
+
+void
+apply_prototype (stack_profile &profile, builtin_prototype const &proto)
+{
+  if (std::get <1> (proto) == yield::pred)
+    return;
+
+  auto const &in = std::get <0> (proto);
+  if (in.size () < profile.size ())
+    profile.erase (profile.end () - in.size (), profile.end ());
+  else
+    profile.clear ();
+
+  // Operators that can produce values of any type declare them as
+  // T_???.  Once a value is unknown, so are all those below it.
+  for (auto const &vt: std::get <2> (proto))
+    if (vt == value::vtype)
+      profile.clear ();
+    else
+      profile.push_back (vt);
+}
+
+void
+merge_profile (stack_profile &profile, stack_profile const &other)
+{
+  auto mm = std::mismatch (profile.rbegin (), profile.rend (),
+			   other.rbegin (), other.rend ());
+  profile.erase (profile.begin (), mm.first.base ());
+}
+
 std::unique_ptr <pred>
 maybe_invert (std::unique_ptr <pred> pred, bool positive)
 {
@@ -70,6 +126,66 @@ maybe_invert (std::unique_ptr <pred> pred, bool positive)
     return std::make_unique <pred_not> (std::move (pred));
 }
 
+namespace
+{
+  // If T is an operand of `==' that consists of a single tree,
+  // return that tree.  Otherwise return nullptr.
+  tree const *
+  eq_operand (tree const &t)
+  {
+    if (t.tt () != tree_type::SUBX_EVAL || t.m_children.size () != 1)
+      return nullptr;
+    tree const &scope = t.child (0);
+    if (scope.tt () != tree_type::SCOPE || scope.m_children.size () != 1)
+      return nullptr;
+    return &scope.child (0);
+  }
+}
+
+tree const *
+match_word_eq (reducible_pred const &rp, char const *word)
+{
+  tree const &t = rp.m_tree;
+  if (t.tt () != tree_type::ASSERT
+      || t.child (0).tt () != tree_type::PRED_SUBX_ANY)
+    return nullptr;
+
+  tree const &scope = t.child (0).child (0);
+  if (scope.tt () != tree_type::SCOPE || scope.m_children.size () != 1)
+    return nullptr;
+
+  // This is what parse_op makes of `A == B'.
+  tree const &cat = scope.child (0);
+  auto is = [&cat] (size_t i, tree_type tt, char const *str)
+    {
+      return cat.child (i).tt () == tt && cat.child (i).str () == str;
+    };
+  if (cat.tt () != tree_type::CAT || cat.m_children.size () != 7
+      || ! is (1, tree_type::BIND, "~a~") || ! is (3, tree_type::BIND, "~b~")
+      || ! is (4, tree_type::READ, "~a~") || ! is (5, tree_type::READ, "~b~")
+      || ! is (6, tree_type::READ, "?eq"))
+    return nullptr;
+
+  tree const *a = eq_operand (cat.child (0));
+  tree const *b = eq_operand (cat.child (2));
+  if (a == nullptr || b == nullptr)
+    return nullptr;
+  if (a->tt () != tree_type::READ)
+    std::swap (a, b);
+
+  auto is_builtin = [&rp] (tree const &rt, char const *name)
+    {
+      builtin const *bi = rp.m_resolve (rt);
+      return bi != nullptr && std::strcmp (bi->name (), name) == 0;
+    };
+
+  if (a->tt () != tree_type::READ
+      || ! is_builtin (*a, word) || ! is_builtin (cat.child (6), "?eq"))
+    return nullptr;
+
+  return b;
+}
+
 vocabulary::vocabulary ()
   : m_builtins {}
 {}
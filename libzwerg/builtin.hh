@@ -30,6 +30,7 @@
 #ifndef _BUILTIN_H_
 #define _BUILTIN_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -42,6 +43,8 @@
 
 struct pred;
 struct op;
+struct tree;
+class builtin;
 
 enum class yield
   {
@@ -68,6 +71,31 @@ using builtin_prototype = std::tuple <std::vector <value_type>, yield,
 				      std::vector <value_type>>;
 using builtin_protomap = std::vector <builtin_prototype>;
 
+// Types of values near TOS that are known when a program is built.
+// rbegin represents TOS.  Nothing is known about values below those.
+using stack_profile = std::vector <value_type>;
+
+// An assertion that immediately follows a builtin in a program.  See
+// builtin::build_reduced for details.
+struct reducible_pred
+{
+  // The assertion as it appears in the program.  Either an ASSERT
+  // node, or a READ of a predicate word.
+  tree const &m_tree;
+
+  // For READ's, the builtin that the word is bound to.  Otherwise
+  // nullptr.
+  builtin const *m_builtin;
+
+  // The predicate built from M_TREE.
+  std::unique_ptr <pred> m_pred;
+
+  // Find builtin that a READ node somewhere inside M_TREE refers to,
+  // or nullptr if the word is not bound to a builtin.  Only usable
+  // for words that are not bound inside M_TREE itself.
+  std::function <builtin const * (tree const &)> m_resolve;
+};
+
 class builtin
 {
 public:
@@ -79,16 +107,60 @@ public:
   virtual std::shared_ptr <op>
   build_exec (layout &l, std::shared_ptr <op> upstream) const;
 
+  // Build an operation that is equivalent to this builtin followed
+  // by assertions PREDS.  This is the "reduction point" of the
+  // builtin: it can use the assertions to avoid producing values that
+  // would be discarded anyway.  The assertions themselves still need
+  // to be applied, the returned op takes ownership of the preds for
+  // that purpose.
+  //
+  // KEEP_POS is false if the program can't observe positions of
+  // values.  The builtin can then yield the values that pass PREDS
+  // with positions other than it would yield them at otherwise.
+  //
+  // Returns nullptr, leaving PREDS intact, if the builtin has nothing
+  // to gain from PREDS.  That's the default.
+  virtual std::shared_ptr <op>
+  build_reduced (layout &l, std::shared_ptr <op> upstream,
+		 std::vector <reducible_pred> &preds, bool keep_pos) const;
+
   virtual char const *name () const = 0;
 
   virtual std::string docstring () const;
   virtual builtin_protomap protomap () const;
+
+  // Return a builtin that does what this one does at places where
+  // values near TOS are known to have types PROFILE, and that is
+  // cheaper to build there.  Overloaded builtins return the overload
+  // that such stacks would be dispatched to.  Returns nullptr if
+  // there's no such builtin.  That's the default.
+  virtual std::shared_ptr <builtin const>
+  peg (stack_profile const &profile) const;
+
+  // Update PROFILE, types of values near TOS before this builtin, to
+  // what is known after it.  The default implementation makes use of
+  // protomap, and if the builtin doesn't declare exactly one
+  // prototype, forgets all types.
+  virtual void stack_effect (stack_profile &profile) const;
 };
 
+// Update PROFILE as an operator with prototype PROTO would.
+void apply_prototype (stack_profile &profile,
+		      builtin_prototype const &proto);
+
+// Update PROFILE to describe stacks described either by PROFILE, or
+// by OTHER.  That keeps only the types near TOS that they agree on.
+void merge_profile (stack_profile &profile, stack_profile const &other);
+
 // Return either PRED, or PRED_NOT(PRED), depending on POSITIVE.
 std::unique_ptr <pred> maybe_invert (std::unique_ptr <pred> pred,
 				     bool positive);
 
+// If the assertion RP is `WORD == X' or `X == WORD', where WORD is a
+// builtin of that name, and X a single tree, return X.  Otherwise
+// return nullptr.
+tree const *match_word_eq (reducible_pred const &rp, char const *word);
+
 class pred_builtin
   : public builtin
 {
@@ -99,6 +171,10 @@ public:
   explicit pred_builtin (bool positive)
     : m_positive {positive}
   {}
+
+  void
+  stack_effect (stack_profile &profile) const override
+  {}
 };
 
 struct vocabulary
@@ -148,6 +224,16 @@ class simple_exec_builtin
     return std::make_shared <Op> (upstream, std::get <I> (args)...);
   }
 
+  template <size_t... I>
+  static void
+  apply_effect (stack_profile &profile,
+		std::index_sequence <I...>,
+		std::tuple <typename std::remove_reference <Args>::type...>
+			const &args)
+  {
+    Op::stack_effect (profile, std::get <I> (args)...);
+  }
+
 public:
   simple_exec_builtin (char const *name, Args... args)
     : m_name {name}
@@ -171,6 +257,12 @@ public:
   {
     return Op::docstring ();
   }
+
+  void
+  stack_effect (stack_profile &profile) const override
+  {
+    apply_effect (profile, std::index_sequence_for <Args...> {}, m_args);
+  }
 };
 
 #endif /* _BUILTIN_H_ */
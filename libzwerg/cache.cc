@@ -28,92 +28,418 @@
 
 #include <cassert>
 #include <algorithm>
-#include <memory>
+#include <cstring>
 
 #include "cache.hh"
+#include "die_index.hh"
 #include "dwpp.hh"
 #include "dwit.hh"
 
+parent_cache::unit_parents::unit_parents (Dwarf_Die cudie)
+  : m_cu {cudie.cu}
+  , m_offsets {dwarf_dieoffset (&cudie)}
+  , m_parents {no_row}
+{}
+
 void
-parent_cache::recursively_populate_unit (unit_cache_t &uc, Dwarf_Die die,
-					 Dwarf_Off paroff)
+parent_cache::unit_parents::add (Dwarf_Off off, Dwarf_Off paroff)
 {
-  while (true)
-    {
-      Dwarf_Off off = dwarf_dieoffset (&die);
-      uc.push_back (std::make_pair (off, paroff));
+  if (paroff == no_off)
+    return;
 
+  // The parent is an ancestor of the previous DIE, or that DIE
+  // itself.
+  uint32_t row = m_offsets.size ();
+  if (m_offsets.back () == paroff)
+    m_stack.push_back (row - 1);
+  else
+    while (m_offsets[m_stack.back ()] != paroff)
       {
-	Dwarf_Die child;
-	if (dwpp_child (die, child))
-	  recursively_populate_unit (uc, child, off);
+	m_stack.pop_back ();
+	assert (! m_stack.empty ());
       }
 
-      switch (dwarf_siblingof (&die, &die))
-	{
-	case 0:
-	  break;
-	case -1:
-	  throw_libdw ();
-	case 1:
-	  return;
-	}
+  m_offsets.push_back (off);
+  m_parents.push_back (m_stack.back ());
+}
+
+void
+parent_cache::add_unit (unit_parents up)
+{
+  if (has_unit (up.m_cu))
+    return;
+
+  m_unit_ids.insert (std::make_pair (up.m_cu, m_units.size ()));
+  if (up.m_cu == m_last_cu)
+    m_last_id = m_units.size ();
+
+  up.m_stack.clear ();
+  up.m_stack.shrink_to_fit ();
+  m_units.push_back (std::move (up));
+}
+
+size_t
+parent_cache::find_unit (Dwarf_CU *cu)
+{
+  if (cu == m_last_cu)
+    {
+      if (m_last_id != no_id)
+	m_stats.m_unit_memo_hits++;
+      return m_last_id;
     }
+
+  auto it = m_unit_ids.find (cu);
+  m_last_cu = cu;
+  m_last_id = it != m_unit_ids.end () ? it->second : no_id;
+  m_last_row = unit_parents::no_row;
+  if (m_last_id != no_id)
+    m_stats.m_unit_hits++;
+  return m_last_id;
 }
 
-parent_cache::unit_cache_t
-parent_cache::populate_unit (Dwarf_Die die)
+Dwarf_Off
+parent_cache::lookup (size_t id, Dwarf_Off off)
 {
-  unit_cache_t uc;
-  recursively_populate_unit (uc, die, no_off);
-  return uc;
+  unit_parents const &up = m_units[id];
+  auto it = std::lower_bound (up.m_offsets.begin (), up.m_offsets.end (),
+			      off);
+  assert (it != up.m_offsets.end ());
+  assert (*it == off);
+
+  m_last_row = up.m_parents[it - up.m_offsets.begin ()];
+  if (m_last_row == unit_parents::no_row)
+    return no_off;
+  return up.m_offsets[m_last_row];
 }
 
 Dwarf_Off
 parent_cache::find (Dwarf_Die die)
 {
-  Dwarf_Die cudie;
-  if (dwarf_diecu (&die, &cudie, nullptr, nullptr) == nullptr)
-    throw_libdw ();
+  Dwarf_Off off = dwarf_dieoffset (&die);
 
-  Dwarf_Off cuoff = dwarf_dieoffset (&cudie);
-  Dwarf *dw = dwarf_cu_getdwarf (die.cu);
-  auto key = std::make_pair (dw, cuoff);
+  // When walking up the tree, the DIE is the previously found parent,
+  // and its own parent is at hand.
+  if (die.cu == m_last_cu && m_last_row != unit_parents::no_row)
+    {
+      unit_parents const &up = m_units[m_last_id];
+      if (up.m_offsets[m_last_row] == off)
+	{
+	  m_stats.m_chain_hits++;
+	  m_last_row = up.m_parents[m_last_row];
+	  if (m_last_row == unit_parents::no_row)
+	    return no_off;
+	  return up.m_offsets[m_last_row];
+	}
+    }
 
-  auto it = m_cache.find (key);
-  if (it == m_cache.end ())
-    it = m_cache.insert (std::make_pair (key, populate_unit (cudie))).first;
+  size_t id = find_unit (die.cu);
+  if (id != no_id)
+    return lookup (id, off);
 
-  Dwarf_Off dieoff = dwarf_dieoffset (&die);
-  auto jt = std::lower_bound
-    (it->second.begin (), it->second.end (), dieoff,
-     [] (std::pair <Dwarf_Off, Dwarf_Off> const &a, Dwarf_Off b)
-     {
-       return a.first < b;
-     });
+  Dwarf_Die cudie = dwpp_cudie (die);
+  if (off == dwarf_dieoffset (&cudie))
+    return no_off;
 
-  assert (jt != it->second.end ());
-  assert (jt->first == dieoff);
-  return jt->second;
+  // Nobody walked this unit yet, so do it now.
+  m_stats.m_walks++;
+  unit_parents up {cudie};
+  cu_iterator cuit {dwarf_cu_getdwarf (die.cu), cudie};
+  all_dies_iterator at (cuit);
+  all_dies_iterator et (++cuit);
+  for (; at != et; ++at)
+    up.add (dwarf_dieoffset (*at), at.parent_offset ());
+  add_unit (std::move (up));
+  return lookup (m_last_id, off);
 }
 
 
-bool
-root_cache::is_root (Dwarf_Die die)
+void
+addr_cache::intervals::add (Dwarf_Addr start, Dwarf_Addr end,
+			    uint64_t value)
+{
+  if (start < end)
+    m_ivs.push_back ({start, end, value});
+}
+
+Dwarf_Addr
+addr_cache::intervals::build (size_t lo, size_t hi)
 {
-  Dwarf *dw = dwarf_cu_getdwarf (die.cu);
-  auto it = m_cache.find (dw);
-  if (it == m_cache.end ())
+  if (lo >= hi)
+    return 0;
+
+  size_t mid = lo + (hi - lo) / 2;
+  m_max_ends[mid] = std::max ({m_ivs[mid].m_end, build (lo, mid),
+			       build (mid + 1, hi)});
+  return m_max_ends[mid];
+}
+
+void
+addr_cache::intervals::build ()
+{
+  std::sort (m_ivs.begin (), m_ivs.end (),
+	     [] (interval const &a, interval const &b)
+	     {
+	       return a.m_start < b.m_start;
+	     });
+  m_ivs.shrink_to_fit ();
+  m_max_ends.resize (m_ivs.size ());
+  build (0, m_ivs.size ());
+}
+
+void
+addr_cache::intervals::find (Dwarf_Addr addr, size_t lo, size_t hi,
+			     std::vector <uint64_t> &ret) const
+{
+  if (lo >= hi)
+    return;
+
+  size_t mid = lo + (hi - lo) / 2;
+  if (m_max_ends[mid] <= addr)
+    // No interval in this range reaches as far as ADDR.
+    return;
+
+  find (addr, lo, mid, ret);
+  if (m_ivs[mid].m_start <= addr)
     {
-      off_vect v;
-      for (auto jt = cu_iterator { dw }; jt != cu_iterator::end (); ++jt)
-	v.push_back (dwarf_dieoffset (*jt));
+      if (addr < m_ivs[mid].m_end)
+	ret.push_back (m_ivs[mid].m_value);
+      find (addr, mid + 1, hi, ret);
+    }
+}
 
-      // Populate the cache for this Dwarf.
-      it = m_cache.insert (std::make_pair (dw, std::move (v))).first;
+void
+addr_cache::intervals::find (Dwarf_Addr addr,
+			     std::vector <uint64_t> &ret) const
+{
+  find (addr, 0, m_ivs.size (), ret);
+}
+
+namespace
+{
+  template <class F>
+  void
+  for_each_range (Dwarf_Die &die, F f)
+  {
+    Dwarf_Addr base;
+    for (ptrdiff_t off = 0;;)
+      {
+	Dwarf_Addr start, end;
+	off = dwarf_ranges (&die, off, &base, &start, &end);
+	if (off < 0)
+	  throw_libdw ();
+	if (off == 0)
+	  break;
+	f (start, end);
+      }
+  }
+
+  bool
+  may_have_ranges (Dwarf_Die &die)
+  {
+    return dwarf_hasattr (&die, DW_AT_low_pc)
+      || dwarf_hasattr (&die, DW_AT_ranges);
+  }
+}
+
+addr_cache::dwarf_addrs &
+addr_cache::get_dwarf (Dwarf *dw)
+{
+  auto it = m_dwarfs.find (dw);
+  if (it != m_dwarfs.end ())
+    return *it->second;
+
+  auto da = std::make_unique <dwarf_addrs> ();
+  std::unordered_map <Dwarf_Off, size_t> ids;
+  std::vector <bool> ranged;
+  for (cu_iterator cuit {dw}; cuit != cu_iterator::end (); ++cuit)
+    {
+      size_t id = da->m_cudies.size ();
+      da->m_cudies.push_back (**cuit);
+      ids.insert (std::make_pair (dwarf_dieoffset (*cuit), id));
+      ranged.push_back (false);
+
+      if (may_have_ranges (**cuit))
+	for_each_range (**cuit, [&] (Dwarf_Addr start, Dwarf_Addr end)
+			{
+			  da->m_units.add (start, end, id);
+			  ranged[id] = true;
+			});
+    }
+
+  // Units don't need to describe their ranges themselves, so add
+  // what .debug_aranges has.  This is not an error if the section is
+  // missing.
+  Dwarf_Aranges *aranges;
+  size_t naranges;
+  if (dwarf_getaranges (dw, &aranges, &naranges) == 0)
+    for (size_t i = 0; i < naranges; ++i)
+      {
+	Dwarf_Addr start;
+	Dwarf_Word length;
+	Dwarf_Off cuoff;
+	if (dwarf_getarangeinfo (dwarf_onearange (aranges, i),
+				 &start, &length, &cuoff) != 0)
+	  throw_libdw ();
+
+	auto jt = ids.find (cuoff);
+	if (jt != ids.end ())
+	  {
+	    da->m_units.add (start, start + length, jt->second);
+	    ranged[jt->second] = true;
+	  }
+      }
+
+  for (size_t id = 0; id < ranged.size (); ++id)
+    if (! ranged[id])
+      da->m_unranged.push_back (id);
+
+  da->m_units.build ();
+  da->m_dies.resize (da->m_cudies.size ());
+  return *m_dwarfs.insert (std::make_pair (dw, std::move (da)))
+    .first->second;
+}
+
+addr_cache::intervals const &
+addr_cache::get_unit (dwarf_addrs &da, size_t id)
+{
+  if (da.m_dies[id] == nullptr)
+    {
+      auto ivs = std::make_unique <intervals> ();
+      Dwarf_Die cudie = da.m_cudies[id];
+      cu_iterator cuit {dwarf_cu_getdwarf (cudie.cu), cudie};
+      all_dies_iterator at (cuit);
+      all_dies_iterator et (++cuit);
+      for (; at != et; ++at)
+	if (may_have_ranges (**at))
+	  {
+	    Dwarf_Off off = dwarf_dieoffset (*at);
+	    for_each_range (**at, [&] (Dwarf_Addr start, Dwarf_Addr end)
+			    {
+			      ivs->add (start, end, off);
+			    });
+	  }
+
+      ivs->build ();
+      da.m_dies[id] = std::move (ivs);
+    }
+
+  return *da.m_dies[id];
+}
+
+std::vector <Dwarf_Off>
+addr_cache::find (Dwarf *dw, Dwarf_Addr addr)
+{
+  dwarf_addrs &da = get_dwarf (dw);
+
+  std::vector <uint64_t> units = da.m_unranged;
+  da.m_units.find (addr, units);
+  std::sort (units.begin (), units.end ());
+  units.erase (std::unique (units.begin (), units.end ()), units.end ());
+
+  std::vector <uint64_t> offs;
+  for (auto id: units)
+    get_unit (da, id).find (addr, offs);
+
+  std::sort (offs.begin (), offs.end ());
+  offs.erase (std::unique (offs.begin (), offs.end ()), offs.end ());
+  return std::vector <Dwarf_Off> (offs.begin (), offs.end ());
+}
+
+
+symbol_cache::module_symbols &
+symbol_cache::get (Dwfl_Module *mod)
+{
+  auto it = m_modules.find (mod);
+  if (it != m_modules.end ())
+    return *it->second;
+
+  int symcount = dwfl_module_getsymtab (mod);
+  if (symcount < 0)
+    throw_libdwfl ();
+
+  auto ms = std::make_unique <module_symbols> ();
+  ms->m_syms.reserve (symcount);
+  for (int i = 0; i < symcount; ++i)
+    {
+      GElf_Sym sym;
+      GElf_Addr addr;
+      GElf_Word shndx;
+      Elf *elf;
+      Dwarf_Addr bias;
+      char const *name = dwfl_module_getsym_info (mod, i, &sym, &addr,
+						  &shndx, &elf, &bias);
+      if (name == nullptr)
+	throw_libdwfl ();
+      ms->m_syms.push_back ({sym, name});
+    }
+
+  return *m_modules.insert (std::make_pair (mod, std::move (ms)))
+    .first->second;
+}
+
+void
+symbol_cache::module_symbols::find_name (char const *name,
+					 std::vector <unsigned> &ret)
+{
+  if (m_by_name.empty () && ! m_syms.empty ())
+    {
+      m_by_name.reserve (m_syms.size ());
+      for (unsigned i = 0; i < m_syms.size (); ++i)
+	m_by_name.push_back
+	  (std::make_pair (die_index::name_hash (m_syms[i].m_name), i));
+      std::sort (m_by_name.begin (), m_by_name.end ());
+    }
+
+  uint32_t hash = die_index::name_hash (name);
+  for (auto it = std::lower_bound (m_by_name.begin (), m_by_name.end (),
+				   std::make_pair (hash, 0u));
+       it != m_by_name.end () && it->first == hash; ++it)
+    if (std::strcmp (m_syms[it->second].m_name, name) == 0)
+      ret.push_back (it->second);
+}
+
+void
+symbol_cache::module_symbols::find_address (GElf_Addr addr,
+					    std::vector <unsigned> &ret)
+{
+  if (m_by_addr.empty () && ! m_syms.empty ())
+    {
+      m_by_addr.resize (m_syms.size ());
+      for (unsigned i = 0; i < m_syms.size (); ++i)
+	m_by_addr[i] = i;
+      std::stable_sort (m_by_addr.begin (), m_by_addr.end (),
+			[this] (unsigned a, unsigned b)
+			{
+			  return m_syms[a].m_sym.st_value
+			    < m_syms[b].m_sym.st_value;
+			});
+    }
+
+  auto it = std::lower_bound (m_by_addr.begin (), m_by_addr.end (), addr,
+			      [this] (unsigned a, GElf_Addr b)
+			      {
+				return m_syms[a].m_sym.st_value < b;
+			      });
+  for (; it != m_by_addr.end () && m_syms[*it].m_sym.st_value == addr; ++it)
+    ret.push_back (*it);
+}
+
+std::vector <Dwarf_CU *> const &
+abbrev_cache::get (Dwarf *dw)
+{
+  auto it = m_dwarfs.find (dw);
+  if (it != m_dwarfs.end ())
+    return it->second;
+
+  std::vector <Dwarf_CU *> cus;
+  std::unordered_set <Dwarf_Off> seen;
+  for (cu_iterator cuit {dw}; cuit != cu_iterator::end (); ++cuit)
+    {
+      Dwarf_CU *cu = (*cuit)->cu;
+      if (seen.insert (dwpp_cu_abbrev_unit_offset (*cu)).second)
+	cus.push_back (cu);
     }
 
-  Dwarf_Off dieoff = dwarf_dieoffset (&die);
-  auto jt = std::lower_bound (it->second.begin (), it->second.end (), dieoff);
-  return jt != it->second.end () && *jt == dieoff;
+  return m_dwarfs.insert (std::make_pair (dw, std::move (cus)))
+    .first->second;
 }
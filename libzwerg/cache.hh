@@ -25,43 +25,213 @@
    You should have received copies of the GNU General Public License and
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
-
 #ifndef _CACHE_H_
 #define _CACHE_H_
 
-#include <map>
-#include <unordered_set>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <elfutils/libdw.h>
+#include <elfutils/libdwfl.h>
 
+// Parents of DIE's.  Producers that walk whole units record parent
+// of each DIE that they pass, so that `parent' usually finds the
+// answer without walking the unit again.  Only when a DIE was
+// reached some other way is its unit walked here.
 class parent_cache
 {
-  using unit_cache_t = std::vector <std::pair <Dwarf_Off, Dwarf_Off>>;
-  using cache_t = std::map <std::pair <Dwarf *, Dwarf_Off>, unit_cache_t>;
+public:
+  static Dwarf_Off const no_off = (Dwarf_Off) -1;
 
-  cache_t m_cache;
+  // Parents of all DIE's of one unit.  Rows are in preorder, which
+  // is also the order of DIE offsets.  Parents are given as rows.
+  class unit_parents
+  {
+    friend class parent_cache;
+    static uint32_t const no_row = (uint32_t) -1;
 
-  void recursively_populate_unit (unit_cache_t &uc, Dwarf_Die die,
-				  Dwarf_Off paroff);
-  unit_cache_t populate_unit (Dwarf_Die die);
+    Dwarf_CU *m_cu;
+    std::vector <Dwarf_Off> m_offsets;
+    std::vector <uint32_t> m_parents;
+
+    // Rows of the ancestors of the most recently added DIE.
+    std::vector <uint32_t> m_stack;
+
+  public:
+    // Start recording a unit whose root DIE is CUDIE.
+    explicit unit_parents (Dwarf_Die cudie);
+
+    // Record DIE at OFF whose parent is at PAROFF.  DIE's have to be
+    // recorded in preorder.  Unit DIE is recorded by the constructor
+    // and is ignored here.
+    void add (Dwarf_Off off, Dwarf_Off paroff);
+  };
+
+  // How lookups were answered.
+  struct stats
+  {
+    // Parent of the previously found parent.
+    uint64_t m_chain_hits = 0;
+
+    // Unit table of the previously looked-up unit.
+    uint64_t m_unit_memo_hits = 0;
+
+    // Unit table that had to be looked up first.
+    uint64_t m_unit_hits = 0;
+
+    // Unit had to be walked.
+    uint64_t m_walks = 0;
+  };
+
+  // Remember parents of a fully walked unit UP.
+  void add_unit (unit_parents up);
+
+  // Whether parents of CU are known already.
+  bool has_unit (Dwarf_CU *cu) const
+  { return m_unit_ids.find (cu) != m_unit_ids.end (); }
 
-public:
-  static Dwarf_Off const no_off = (Dwarf_Off) -1;
   Dwarf_Off find (Dwarf_Die die);
+
+  stats const &get_stats () const { return m_stats; }
+
+private:
+  // Unit tables, numbered in the order in which they were added.
+  std::vector <unit_parents> m_units;
+  std::unordered_map <Dwarf_CU *, size_t> m_unit_ids;
+
+  // Unit of the last lookup.  M_LAST_ID is its number in M_UNITS, or
+  // no_id if it has no table.
+  static size_t const no_id = (size_t) -1;
+  Dwarf_CU *m_last_cu = nullptr;
+  size_t m_last_id = no_id;
+
+  // Row in the last unit where the last looked-up parent was.
+  // `parent*' asks about that DIE next.
+  uint32_t m_last_row = unit_parents::no_row;
+
+  stats m_stats;
+
+  size_t find_unit (Dwarf_CU *cu);
+  Dwarf_Off lookup (size_t id, Dwarf_Off off);
 };
 
-class root_cache
+// Index of address ranges of DIE's, for finding DIE's that cover a
+// given address.  For each Dwarf, address ranges of units are taken
+// from .debug_aranges and from unit DIE's.  These are used to find
+// candidate units, whose DIE's are then looked up in a per-unit
+// index.  That is built when the unit is first searched.
+class addr_cache
 {
-  using off_vect = std::vector <Dwarf_Off>;
-  using cache_t = std::map <Dwarf *, off_vect>;
+  // A set of possibly overlapping address intervals, each with a
+  // value.  Intervals are sorted by start address.  They form an
+  // implicit binary search tree, where the middle interval of each
+  // range is the root of that range.  M_MAX_ENDS at that root holds
+  // the largest end address in the range.
+  class intervals
+  {
+    struct interval
+    {
+      Dwarf_Addr m_start;
+      Dwarf_Addr m_end;
+      uint64_t m_value;
+    };
+
+    std::vector <interval> m_ivs;
+    std::vector <Dwarf_Addr> m_max_ends;
+
+    Dwarf_Addr build (size_t lo, size_t hi);
+    void find (Dwarf_Addr addr, size_t lo, size_t hi,
+	       std::vector <uint64_t> &ret) const;
+
+  public:
+    void add (Dwarf_Addr start, Dwarf_Addr end, uint64_t value);
+    void build ();
+
+    // Append to RET values of intervals that contain ADDR.
+    void find (Dwarf_Addr addr, std::vector <uint64_t> &ret) const;
+  };
+
+  struct dwarf_addrs
+  {
+    std::vector <Dwarf_Die> m_cudies;
+
+    // Indices of units whose address ranges were found, and of those
+    // that have none.  The latter have to be searched every time.
+    intervals m_units;
+    std::vector <uint64_t> m_unranged;
+
+    // Index of each unit, or nullptr if not built yet.  Values of
+    // the intervals are DIE offsets.
+    std::vector <std::unique_ptr <intervals>> m_dies;
+  };
+
+  std::unordered_map <Dwarf *, std::unique_ptr <dwarf_addrs>> m_dwarfs;
+
+  dwarf_addrs &get_dwarf (Dwarf *dw);
+  intervals const &get_unit (dwarf_addrs &da, size_t id);
 
-  cache_t m_cache;
+public:
+  // Return offsets of DIE's in DW whose address ranges contain ADDR,
+  // in ascending order.
+  std::vector <Dwarf_Off> find (Dwarf *dw, Dwarf_Addr addr);
+};
 
+// Symbol tables of Dwfl modules, read once and indexed by address
+// and by name.
+class symbol_cache
+{
 public:
-  bool is_root (Dwarf_Die die);
+  struct symbol
+  {
+    GElf_Sym m_sym;
+    char const *m_name;
+  };
+
+  class module_symbols
+  {
+    friend class symbol_cache;
+
+    // Symbols in the order of their indices.
+    std::vector <symbol> m_syms;
+
+    // Symbol indices sorted by st_value, and by hash of the name.
+    // Built on first lookup.
+    std::vector <unsigned> m_by_addr;
+    std::vector <std::pair <uint32_t, unsigned>> m_by_name;
+
+  public:
+    unsigned size () const { return m_syms.size (); }
+    symbol const &at (unsigned idx) const { return m_syms[idx]; }
+
+    // Append to RET indices of symbols named NAME, in ascending order.
+    void find_name (char const *name, std::vector <unsigned> &ret);
+
+    // Append to RET indices of symbols whose st_value is ADDR, in
+    // ascending order.
+    void find_address (GElf_Addr addr, std::vector <unsigned> &ret);
+  };
+
+  module_symbols &get (Dwfl_Module *mod);
+
+private:
+  std::unordered_map <Dwfl_Module *,
+		      std::unique_ptr <module_symbols>> m_modules;
 };
 
+// Abbreviation units of Dwarf files.  Many units may share one
+// abbreviation unit, so for each Dwarf, this remembers the first unit
+// that uses each of its abbreviation units.
+class abbrev_cache
+{
+  std::unordered_map <Dwarf *, std::vector <Dwarf_CU *>> m_dwarfs;
+
+public:
+  // Return, for each abbreviation unit of DW, the first unit that
+  // uses it.  Units are in the order in which they are in DW.
+  std::vector <Dwarf_CU *> const &get (Dwarf *dw);
+};
 
 #endif /* _CACHE_H_ */
@@ -31,10 +31,52 @@
 #include <string.h>
 #include <inttypes.h>
 #include <elfutils/libdw.h>
+#include <algorithm>
 
 #include "flag_saver.hh"
 
-coverage::const_iterator
+namespace
+{
+  // Append R to RANGES, which are sorted and end at or before R
+  // starts.  Coalesce R with the last range if they touch.
+  void
+  append_range (std::vector<cov_range> &ranges, cov_range const &r)
+  {
+    if (! ranges.empty () && r.start <= ranges.back ().end ())
+      {
+	cov_range &last = ranges.back ();
+	if (r.end () > last.end ())
+	  last.length = r.end () - last.start;
+      }
+    else
+      ranges.push_back (r);
+  }
+}
+
+coverage::coverage (ranges_t ranges)
+{
+  if (! ranges.empty ())
+    m_ranges = std::make_shared<ranges_t> (std::move (ranges));
+}
+
+coverage::ranges_t const &
+coverage::ranges () const
+{
+  static ranges_t const no_ranges;
+  return m_ranges != nullptr ? *m_ranges : no_ranges;
+}
+
+coverage::ranges_t &
+coverage::mut_ranges ()
+{
+  if (m_ranges == nullptr)
+    m_ranges = std::make_shared<ranges_t> ();
+  else if (m_ranges.use_count () > 1)
+    m_ranges = std::make_shared<ranges_t> (*m_ranges);
+  return *m_ranges;
+}
+
+size_t
 coverage::find (uint64_t start) const
 {
   assert (!empty ());
@@ -52,17 +94,34 @@ coverage::find (uint64_t start) const
       else if (r.start < start)
 	a = i + 1;
       else
-	return begin () + i;
+	return i;
     }
 
-  return begin () + a;
+  return a;
 }
 
-coverage::iterator
-coverage::find (uint64_t start)
+void
+coverage::builder::add (uint64_t start, uint64_t length)
+{
+  if (length != 0)
+    m_ranges.push_back ((struct cov_range){start, length});
+}
+
+coverage
+coverage::builder::build ()
 {
-  const_iterator it = const_cast<coverage const *> (this)->find (start);
-  return begin () + (it - begin ());
+  std::sort (m_ranges.begin (), m_ranges.end (),
+	     [] (cov_range const &a, cov_range const &b)
+	     {
+	       return a.start < b.start;
+	     });
+
+  ranges_t ret;
+  for (auto const &r: m_ranges)
+    append_range (ret, r);
+
+  m_ranges.clear ();
+  return coverage {std::move (ret)};
 }
 
 void
@@ -74,19 +133,21 @@ coverage::add (uint64_t start, uint64_t length)
   cov_range nr = (struct cov_range){start, length};
   if (empty ())
     {
-      push_back (nr);
+      mut_ranges ().push_back (nr);
       return;
     }
 
-  iterator r_i = find (start);
+  size_t idx = find (start);
+  ranges_t &v = mut_ranges ();
+  ranges_t::iterator r_i = v.begin () + idx;
 
   cov_range *to_insert = &nr;
   cov_range *coalesce = &nr;
 
   // Coalesce with previous range?
-  if (r_i > begin ())
+  if (r_i > v.begin ())
     {
-      iterator p_i = r_i - 1;
+      ranges_t::iterator p_i = r_i - 1;
       if (coalesce->start <= p_i->start + p_i->length)
 	{
 	  uint64_t coalesce_end = coalesce->start + coalesce->length;
@@ -102,10 +163,10 @@ coverage::add (uint64_t start, uint64_t length)
     }
 
   // Coalesce with one or more following ranges?
-  if (coalesce != NULL && r_i != end ())
+  if (coalesce != NULL && r_i != v.end ())
     {
-      iterator p_i = r_i;
-      while (p_i != end ()
+      ranges_t::iterator p_i = r_i;
+      while (p_i != v.end ()
 	     && coalesce->start + coalesce->length >= p_i->start)
 	{
 	  uint64_t p_end = p_i->start + p_i->length;
@@ -122,13 +183,13 @@ coverage::add (uint64_t start, uint64_t length)
 	  ++p_i;
 	}
       if (p_i > r_i)
-	erase (r_i, p_i);
+	v.erase (r_i, p_i);
     }
 
   if (to_insert != NULL)
     {
-      size_t idx = r_i - begin ();
-      insert (begin () + idx, *to_insert);
+      size_t idx = r_i - v.begin ();
+      v.insert (v.begin () + idx, *to_insert);
     }
 }
 
@@ -140,15 +201,17 @@ coverage::remove (uint64_t start,
     return false;
 
   uint64_t a_end = start + length;
-  iterator r_i = find (start);
-  iterator erase_begin_i = end ();
-  iterator erase_end_i = r_i; // end exclusive
+  size_t idx = find (start);
+  ranges_t &v = mut_ranges ();
+  ranges_t::iterator r_i = v.begin () + idx;
+  ranges_t::iterator erase_begin_i = v.end ();
+  ranges_t::iterator erase_end_i = r_i; // end exclusive
   bool overlap = false;
 
   // Cut from previous range?
-  if (r_i > begin ())
+  if (r_i > v.begin ())
     {
-      iterator p_i = r_i - 1;
+      ranges_t::iterator p_i = r_i - 1;
       if (start < p_i->start + p_i->length)
 	{
 	  uint64_t r_end = p_i->start + p_i->length;
@@ -172,11 +235,11 @@ coverage::remove (uint64_t start,
 	}
     }
 
-  if (erase_begin_i == end ())
+  if (erase_begin_i == v.end ())
     erase_begin_i = r_i;
 
   // Cut from next range?
-  while (r_i < end () && r_i->start < a_end)
+  while (r_i < v.end () && r_i->start < a_end)
     {
       overlap = true;
       if (a_end >= r_i->start + r_i->length)
@@ -195,7 +258,7 @@ coverage::remove (uint64_t start,
 
   // Did we cut out anything completely?
   if (erase_end_i > erase_begin_i)
-    erase (erase_begin_i, erase_end_i);
+    v.erase (erase_begin_i, erase_end_i);
 
   return overlap;
 }
@@ -206,13 +269,14 @@ coverage::is_covered (uint64_t start, uint64_t length) const
   if (empty ())
     return false;
 
-  const_iterator r_i = find (start);
+  ranges_t const &v = ranges ();
+  ranges_t::const_iterator r_i = v.begin () + find (start);
   uint64_t a_end = start + length;
-  if (r_i < end ())
+  if (r_i < v.end ())
     if (start >= r_i->start)
       return a_end <= r_i->start + r_i->length;
 
-  if (r_i > begin ())
+  if (r_i > v.begin ())
     {
       --r_i;
       return a_end <= r_i->start + r_i->length;
@@ -271,12 +335,13 @@ coverage::is_overlap (uint64_t start, uint64_t length) const
     return is_covered (start, length);
 
   uint64_t a_end = start + length;
-  const_iterator r_i = find (start);
+  ranges_t const &v = ranges ();
+  ranges_t::const_iterator r_i = v.begin () + find (start);
 
-  if (r_i < end () && overlaps (start, a_end, *r_i))
+  if (r_i < v.end () && overlaps (start, a_end, *r_i))
     return true;
 
-  if (r_i > begin ())
+  if (r_i > v.begin ())
     return overlaps (start, a_end, *--r_i);
 
   return false;
@@ -288,21 +353,22 @@ coverage::intersect (uint64_t start, uint64_t length) const
   if (empty () || length == 0)
     return coverage {};
 
-  auto r_i = find (start);
+  ranges_t const &v = ranges ();
+  auto r_i = v.begin () + find (start);
   uint64_t a_end = start + length;
 
   coverage ret;
 
   // Handle intersection with previous range.
-  if (r_i > begin ())
+  if (r_i > v.begin ())
     {
       auto j = r_i - 1;
       if (start < j->start + j->length)
-	ret.add (start, j->start + j->length - start);
+	ret.add (start, std::min (j->start + j->length, a_end) - start);
     }
 
   // Handle intersection with following ranges.
-  for (; r_i < end () && a_end > r_i->start; ++r_i)
+  for (; r_i < v.end () && a_end > r_i->start; ++r_i)
     {
       uint64_t b_end = r_i->start + r_i->length;
       ret.add (r_i->start, std::min (b_end, a_end) - r_i->start);
@@ -323,8 +389,9 @@ coverage::find_holes (uint64_t start, uint64_t length,
   if (empty ())
     return hole (start, length, user_data);
 
-  if (start < front ().start)
-    if (!hole (start, front ().start - start, user_data))
+  ranges_t const &v = ranges ();
+  if (start < v.front ().start)
+    if (!hole (start, v.front ().start - start, user_data))
       return false;
 
   for (size_t i = 0; i < size () - 1; ++i)
@@ -334,9 +401,9 @@ coverage::find_holes (uint64_t start, uint64_t length,
 	return false;
     }
 
-  if (start + length > back ().end ())
+  if (start + length > v.back ().end ())
     {
-      uint64_t end_last = back ().end ();
+      uint64_t end_last = v.back ().end ();
       return hole (end_last, start + length - end_last, user_data);
     }
 
@@ -347,28 +414,106 @@ bool
 coverage::find_ranges (bool (*cb)(uint64_t start, uint64_t length, void *data),
 		       void *user_data) const
 {
-  for (const_iterator it = begin (); it != end (); ++it)
-    if (!cb (it->start, it->length, user_data))
+  for (auto const &r: ranges ())
+    if (!cb (r.start, r.length, user_data))
       return false;
 
   return true;
 }
 
+coverage
+coverage::intersect (coverage const &other) const
+{
+  ranges_t const &a = ranges ();
+  ranges_t const &b = other.ranges ();
+  ranges_t ret;
+
+  auto a_i = a.begin ();
+  auto b_i = b.begin ();
+  while (a_i != a.end () && b_i != b.end ())
+    {
+      uint64_t start = std::max (a_i->start, b_i->start);
+      uint64_t end = std::min (a_i->end (), b_i->end ());
+      if (start < end)
+	append_range (ret, (struct cov_range){start, end - start});
+
+      if (a_i->end () < b_i->end ())
+	++a_i;
+      else
+	++b_i;
+    }
+
+  return coverage {std::move (ret)};
+}
+
 void
 coverage::add_all (coverage const &other)
 {
-  for (size_t i = 0; i < other.size (); ++i)
-    add (other[i].start, other[i].length);
+  if (other.empty ())
+    return;
+  if (empty ())
+    {
+      m_ranges = other.m_ranges;
+      return;
+    }
+
+  // Merge the two sorted sequences, instead of adding the ranges one
+  // at a time.
+  ranges_t const &a = ranges ();
+  ranges_t const &b = other.ranges ();
+  ranges_t ret;
+  ret.reserve (a.size () + b.size ());
+
+  auto a_i = a.begin ();
+  auto b_i = b.begin ();
+  while (a_i != a.end () || b_i != b.end ())
+    if (b_i == b.end () || (a_i != a.end () && a_i->start <= b_i->start))
+      append_range (ret, *a_i++);
+    else
+      append_range (ret, *b_i++);
+
+  *this = coverage {std::move (ret)};
 }
 
 bool
 coverage::remove_all (coverage const &other)
 {
-  bool ret = false;
-  for (size_t i = 0; i < other.size (); ++i)
-    if (remove (other[i].start, other[i].length))
-      ret = true;
-  return ret;
+  if (empty () || other.empty ())
+    return false;
+
+  ranges_t const &a = ranges ();
+  ranges_t const &b = other.ranges ();
+  ranges_t ret;
+  bool overlap = false;
+
+  auto b_i = b.begin ();
+  for (auto const &r: a)
+    {
+      uint64_t start = r.start;
+      uint64_t end = r.end ();
+
+      // Ranges of OTHER that end before R starts won't be needed for
+      // any of the following ranges either.
+      while (b_i != b.end () && b_i->end () <= start)
+	++b_i;
+
+      for (auto b_j = b_i; b_j != b.end () && b_j->start < end; ++b_j)
+	{
+	  overlap = true;
+	  if (b_j->start > start)
+	    ret.push_back ((struct cov_range){start, b_j->start - start});
+	  start = b_j->end ();
+	  if (start >= end)
+	    break;
+	}
+
+      if (start < end)
+	ret.push_back ((struct cov_range){start, end - start});
+    }
+
+  if (overlap)
+    *this = coverage {std::move (ret)};
+  return overlap;
 }
 
 coverage
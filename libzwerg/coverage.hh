@@ -27,6 +27,7 @@
 #ifndef DWARFLINT_COVERAGE_HH
 #define DWARFLINT_COVERAGE_HH
 
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -51,15 +52,39 @@ struct cov_range
 };
 
 struct coverage
-  : private std::vector<cov_range>
 {
-  iterator find (uint64_t start);
-  const_iterator find (uint64_t start) const;
+private:
+  typedef std::vector<cov_range> ranges_t;
+
+  // Copies of a coverage share their ranges.  The ranges are copied
+  // when a coverage that shares them is about to be modified.  Null
+  // stands for an empty coverage.
+  std::shared_ptr<ranges_t> m_ranges;
+
+  explicit coverage (ranges_t ranges);
+
+  ranges_t const &ranges () const;
+  ranges_t &mut_ranges ();
+  size_t find (uint64_t start) const;
 
 public:
-  using std::vector <cov_range>::size;
-  using std::vector <cov_range>::empty;
-  using std::vector <cov_range>::at;
+  /// Collects ranges in arbitrary order, and then builds a coverage
+  /// out of them in one go.  That's cheaper than adding the ranges
+  /// one by one, which needs to move the ranges that follow.
+  class builder
+  {
+    ranges_t m_ranges;
+
+  public:
+    void add (uint64_t start, uint64_t length);
+    coverage build ();
+  };
+
+  coverage () = default;
+
+  size_t size () const { return ranges ().size (); }
+  bool empty () const { return ranges ().empty (); }
+  cov_range const &at (size_t idx) const { return ranges ().at (idx); }
 
   void add (uint64_t start, uint64_t length);
 
@@ -94,6 +119,10 @@ public:
   /// START/LENGTH don't overlap with this coverage at all.
   coverage intersect (uint64_t start, uint64_t length) const;
 
+  /// Returns a coverage of addresses covered by both this coverage
+  /// and OTHER.
+  coverage intersect (coverage const &other) const;
+
   bool find_holes (uint64_t start, uint64_t length,
 		   bool (*cb)(uint64_t start, uint64_t length, void *data),
 		   void *data) const;
@@ -102,7 +131,7 @@ public:
   coverage operator- (coverage const &rhs) const;
   bool operator== (coverage const &rhs) const
   {
-    return static_cast<std::vector<cov_range> > (rhs) == *this;
+    return m_ranges == rhs.m_ranges || ranges () == rhs.ranges ();
   }
 };
 
@@ -0,0 +1,517 @@
+/*
+   Copyright (C) 2026 Petr Machata
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <dwarf.h>
+#include <elfutils/libdwelf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "die_index.hh"
+#include "dwfl_context.hh"
+#include "dwit.hh"
+#include "dwmods.hh"
+#include "dwpp.hh"
+
+void
+die_filter::add_name (std::string name)
+{
+  m_name_hashes.push_back (die_index::name_hash (name.c_str ()));
+  m_names.push_back (std::move (name));
+}
+
+bool
+die_filter::empty () const
+{
+  return m_tags.empty () && m_atnames.empty () && m_names.empty ()
+    && m_offsets.empty ();
+}
+
+bool
+die_filter::passes_offset (Dwarf_Off off) const
+{
+  return std::all_of (m_offsets.begin (), m_offsets.end (),
+		      [off] (Dwarf_Off o) { return o == off; });
+}
+
+bool
+die_filter::may_pass (Dwarf_Die &die, bool cooked) const
+{
+  if (! passes_offset (dwarf_dieoffset (&die)))
+    return false;
+
+  for (auto const &tag: m_tags)
+    if ((dwarf_tag (&die) == tag.first) != tag.second)
+      return false;
+
+  bool integrates = cooked && (dwarf_hasattr (&die, DW_AT_specification)
+			       || dwarf_hasattr (&die, DW_AT_abstract_origin));
+
+  for (auto const &at: m_atnames)
+    if (at.second)
+      {
+	if (! dwarf_hasattr (&die, at.first) && ! integrates)
+	  return false;
+      }
+    else if (dwarf_hasattr (&die, at.first))
+      return false;
+
+  for (auto const &name: m_names)
+    if (cooked)
+      {
+	// This is what `name' does for cooked DIE's.
+	char const *str = dwarf_diename (&die);
+	if (str == nullptr || name != str)
+	  return false;
+      }
+    else
+      {
+	Dwarf_Attribute at;
+	if (dwarf_attr (&die, DW_AT_name, &at) == nullptr)
+	  return false;
+
+	// Leave reporting of malformed names to `name'.
+	char const *str = dwarf_formstring (&at);
+	if (str != nullptr && name != str)
+	  return false;
+      }
+
+  return true;
+}
+
+namespace
+{
+  // Bump this whenever the layout of the index file changes.
+  uint64_t const index_magic = 0x315844495744575aULL; // "ZWDWIDX1"
+  uint64_t const index_version = 2;
+
+  // Attributes are recorded in a 128-bit bitmap.  The last bit stands
+  // for all attributes with codes that don't fit.
+  unsigned const attr_overflow = 127;
+
+  unsigned
+  attr_bit (unsigned atname)
+  {
+    return std::min (atname, attr_overflow);
+  }
+
+  size_t
+  words_for (size_t n, size_t elsize)
+  {
+    return (n * elsize + sizeof (uint64_t) - 1) / sizeof (uint64_t);
+  }
+
+  // The index is laid out as a sequence of 64-bit words: first the
+  // key (see index_key), then the number of indexed Dwarf's, and then
+  // for each Dwarf the number of rows followed by the columns.  Each
+  // column is padded to a whole number of words.
+  struct index_builder
+  {
+    std::vector <uint64_t> m_offsets;
+    std::vector <uint64_t> m_parents;
+    std::vector <uint64_t> m_attrs;
+    std::vector <uint32_t> m_name_hashes;
+    std::vector <uint16_t> m_tags;
+
+    static int
+    collect_attr (Dwarf_Attribute *at, void *data)
+    {
+      auto attrs = static_cast <uint64_t *> (data);
+      unsigned bit = attr_bit (dwarf_whatattr (at));
+      attrs[bit / 64] |= (uint64_t) 1 << (bit % 64);
+      return DWARF_CB_OK;
+    }
+
+    void
+    add_die (Dwarf_Die die, Dwarf_Off paroff)
+    {
+      uint64_t attrs[2] = {0, 0};
+      if (dwarf_getattrs (&die, &collect_attr, attrs, 0) == -1)
+	throw_libdw ();
+
+      // A name that's not a string is left for `name' to report, so
+      // its hash stays unknown.
+      uint32_t hash = die_index::unknown_hash;
+      Dwarf_Attribute at;
+      if (dwarf_attr (&die, DW_AT_name, &at) != nullptr)
+	if (char const *name = dwarf_formstring (&at))
+	  hash = die_index::name_hash (name);
+
+      m_offsets.push_back (dwarf_dieoffset (&die));
+      m_parents.push_back (paroff);
+      m_attrs.push_back (attrs[0]);
+      m_attrs.push_back (attrs[1]);
+      m_name_hashes.push_back (hash);
+      m_tags.push_back (dwarf_tag (&die));
+    }
+
+    void
+    recursively_add_dies (Dwarf_Die die, Dwarf_Off paroff)
+    {
+      while (true)
+	{
+	  add_die (die, paroff);
+
+	  Dwarf_Die child;
+	  if (dwpp_child (die, child))
+	    recursively_add_dies (child, dwarf_dieoffset (&die));
+
+	  switch (dwarf_siblingof (&die, &die))
+	    {
+	    case 0:
+	      break;
+	    case -1:
+	      throw_libdw ();
+	    case 1:
+	      return;
+	    }
+	}
+    }
+
+    template <class T>
+    static void
+    append (std::vector <uint64_t> &image, std::vector <T> const &col)
+    {
+      size_t pos = image.size ();
+      image.resize (pos + words_for (col.size (), sizeof (T)), 0);
+      if (! col.empty ())
+	std::memcpy (&image[pos], col.data (), col.size () * sizeof (T));
+    }
+
+    void
+    build (Dwarf *dw, std::vector <uint64_t> &image)
+    {
+      for (auto it = cu_iterator {dw}; it != cu_iterator::end (); ++it)
+	recursively_add_dies (**it, die_index::no_off);
+
+      image.push_back (m_offsets.size ());
+      append (image, m_offsets);
+      append (image, m_parents);
+      append (image, m_attrs);
+      append (image, m_name_hashes);
+      append (image, m_tags);
+    }
+  };
+
+  void
+  append_bytes (std::vector <uint64_t> &key, void const *bytes, size_t len)
+  {
+    key.push_back (len);
+    size_t pos = key.size ();
+    key.resize (pos + words_for (len, 1), 0);
+    std::memcpy (&key[pos], bytes, len);
+  }
+
+  // Key identifying the file that the index was built for, and the
+  // alternate file that its DIE's may refer to.  The index is only
+  // valid if it starts with the same key.
+  bool
+  index_key (dwfl_context &dwctx, std::vector <uint64_t> &key,
+	     std::string &name)
+  {
+    auto it = dwfl_module_iterator {dwctx.get_dwfl ()};
+    if (it == dwfl_module_iterator::end ())
+      return false;
+    Dwfl_Module *mod = *it;
+    if (++it != dwfl_module_iterator::end ())
+      return false;
+
+    const unsigned char *bits;
+    GElf_Addr vaddr;
+    int len = dwfl_module_build_id (mod, &bits, &vaddr);
+    if (len <= 0)
+      return false;
+
+    const char *mainfile = nullptr;
+    dwfl_module_info (mod, nullptr, nullptr, nullptr, nullptr, nullptr,
+		      &mainfile, nullptr);
+    struct stat st;
+    if (mainfile == nullptr || stat (mainfile, &st) != 0)
+      return false;
+
+    key = {index_magic, index_version, (uint64_t) st.st_size,
+	   (uint64_t) st.st_mtim.tv_sec, (uint64_t) st.st_mtim.tv_nsec};
+    append_bytes (key, bits, len);
+
+    // The alternate file is found through its build ID, and can be
+    // replaced while the main file stays as it is.  Its own build ID
+    // and size identify it.
+    Dwarf_Addr bias;
+    Dwarf *dw = dwfl_module_getdwarf (mod, &bias);
+    if (Dwarf *alt = dw != nullptr ? dwarf_getalt (dw) : nullptr)
+      {
+	Elf *elf = dwarf_getelf (alt);
+	void const *altbits;
+	size_t altsize;
+	ssize_t altlen = elf != nullptr
+	  ? dwelf_elf_gnu_build_id (elf, &altbits) : -1;
+	if (altlen <= 0 || elf_rawfile (elf, &altsize) == nullptr)
+	  return false;
+	key.push_back (altsize);
+	append_bytes (key, altbits, altlen);
+      }
+    else
+      key.push_back (0);
+
+    static char const digits[] = "0123456789abcdef";
+    name.clear ();
+    for (int i = 0; i < len; ++i)
+      {
+	name += digits[bits[i] >> 4];
+	name += digits[bits[i] & 0xf];
+      }
+    name += ".zwidx";
+
+    return true;
+  }
+
+  void
+  write_index (std::string const &path, std::vector <uint64_t> const &image)
+  {
+    // Write to a temporary file first, so that concurrent readers
+    // never see a partially written index.
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp (&tmp[0]);
+    if (fd < 0)
+      return;
+
+    auto data = reinterpret_cast <char const *> (image.data ());
+    size_t size = image.size () * sizeof (uint64_t);
+    while (size > 0)
+      {
+	ssize_t ret = write (fd, data, size);
+	if (ret <= 0)
+	  break;
+	data += ret;
+	size -= ret;
+      }
+
+    if (close (fd) != 0 || size > 0
+	|| rename (tmp.c_str (), path.c_str ()) != 0)
+      unlink (tmp.c_str ());
+  }
+}
+
+die_index::die_index ()
+  : m_map {nullptr}
+  , m_map_size {0}
+{}
+
+die_index::~die_index ()
+{
+  if (m_map != nullptr)
+    munmap (m_map, m_map_size);
+}
+
+uint32_t
+die_index::name_hash (char const *name)
+{
+  // FNV-1a.  This needs to be stable, because the hashes are stored.
+  uint32_t hash = 2166136261u;
+  for (; *name != '\0'; ++name)
+    {
+      hash ^= (unsigned char) *name;
+      hash *= 16777619u;
+    }
+  return hash != unknown_hash ? hash : 1;
+}
+
+bool
+die_index::attach (uint64_t const *words, size_t nwords,
+		   std::vector <uint64_t> const &key,
+		   std::vector <Dwarf *> const &dwarfs)
+{
+  uint64_t const *end = words + nwords;
+  auto take = [&] (size_t n) -> uint64_t const *
+    {
+      if ((size_t) (end - words) < n)
+	return nullptr;
+      uint64_t const *ret = words;
+      words += n;
+      return ret;
+    };
+
+  uint64_t const *k = take (key.size ());
+  if (k == nullptr || ! std::equal (key.begin (), key.end (), k))
+    return false;
+
+  uint64_t const *ndwarfs = take (1);
+  if (ndwarfs == nullptr || *ndwarfs != dwarfs.size ())
+    return false;
+
+  m_tables.clear ();
+  for (Dwarf *dw: dwarfs)
+    {
+      uint64_t const *nrows = take (1);
+      if (nrows == nullptr || *nrows > nwords)
+	return false;
+
+      table tab;
+      tab.m_dw = dw;
+      tab.m_size = *nrows;
+      tab.m_offsets = take (words_for (*nrows, sizeof (uint64_t)));
+      tab.m_parents = take (words_for (*nrows, sizeof (uint64_t)));
+      tab.m_attrs = take (words_for (2 * *nrows, sizeof (uint64_t)));
+      auto hashes = take (words_for (*nrows, sizeof (uint32_t)));
+      auto tags = take (words_for (*nrows, sizeof (uint16_t)));
+      if (tab.m_offsets == nullptr || tab.m_parents == nullptr
+	  || tab.m_attrs == nullptr || hashes == nullptr || tags == nullptr)
+	return false;
+
+      tab.m_name_hashes = reinterpret_cast <uint32_t const *> (hashes);
+      tab.m_tags = reinterpret_cast <uint16_t const *> (tags);
+      m_tables.push_back (tab);
+    }
+
+  return words == end;
+}
+
+std::unique_ptr <die_index>
+die_index::open (dwfl_context &dwctx)
+{
+  char const *dir = getenv ("DWGREP_INDEX_DIR");
+  if (dir == nullptr || *dir == '\0')
+    return nullptr;
+
+  std::vector <uint64_t> key;
+  std::string name;
+  if (! index_key (dwctx, key, name))
+    return nullptr;
+
+  std::string path = std::string (dir) + "/" + name;
+  std::vector <Dwarf *> dwarfs = all_dwarfs (dwctx);
+  std::unique_ptr <die_index> ret {new die_index ()};
+
+  int fd = ::open (path.c_str (), O_RDONLY);
+  if (fd >= 0)
+    {
+      struct stat st;
+      if (fstat (fd, &st) == 0 && st.st_size > 0
+	  && st.st_size % sizeof (uint64_t) == 0)
+	{
+	  void *map = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	  if (map != MAP_FAILED)
+	    {
+	      ret->m_map = map;
+	      ret->m_map_size = st.st_size;
+	    }
+	}
+      close (fd);
+
+      if (ret->m_map != nullptr
+	  && ret->attach (static_cast <uint64_t const *> (ret->m_map),
+			  ret->m_map_size / sizeof (uint64_t), key, dwarfs))
+	return ret;
+
+      // Stale or damaged index.  Rebuild it.
+      ret = std::unique_ptr <die_index> {new die_index ()};
+    }
+
+  ret->m_image = key;
+  ret->m_image.push_back (dwarfs.size ());
+  for (Dwarf *dw: dwarfs)
+    index_builder {}.build (dw, ret->m_image);
+
+  bool attached = ret->attach (ret->m_image.data (), ret->m_image.size (),
+			       key, dwarfs);
+  assert (attached);
+  (void) attached;
+
+  write_index (path, ret->m_image);
+  return ret;
+}
+
+die_index::table const *
+die_index::find_table (Dwarf *dw) const
+{
+  for (auto const &tab: m_tables)
+    if (tab.m_dw == dw)
+      return &tab;
+  return nullptr;
+}
+
+size_t
+die_index::table::find (Dwarf_Off off) const
+{
+  auto it = std::lower_bound (m_offsets, m_offsets + m_size, off);
+  if (it != m_offsets + m_size && *it == off)
+    return it - m_offsets;
+  return m_size;
+}
+
+bool
+die_index::table::has_attr (size_t row, unsigned atname) const
+{
+  unsigned bit = attr_bit (atname);
+  return (m_attrs[2 * row + bit / 64] >> (bit % 64)) & 1;
+}
+
+bool
+die_index::table::may_pass (size_t row, die_filter const &flt,
+			    bool cooked) const
+{
+  if (! flt.passes_offset (m_offsets[row]))
+    return false;
+
+  for (auto const &tag: flt.m_tags)
+    if ((m_tags[row] == tag.first) != tag.second)
+      return false;
+
+  // Cooked DIE's may get attributes from a DIE that they reference.
+  bool integrates = cooked && (has_attr (row, DW_AT_specification)
+			       || has_attr (row, DW_AT_abstract_origin));
+
+  // N.B. for attributes that share the overflow bit, a set bit only
+  // means that the DIE might have the attribute.
+  for (auto const &at: flt.m_atnames)
+    if (at.second)
+      {
+	if (! has_attr (row, at.first) && ! integrates)
+	  return false;
+      }
+    else if (attr_bit (at.first) != attr_overflow
+	     && has_attr (row, at.first))
+      return false;
+
+  for (uint32_t hash: flt.m_name_hashes)
+    if (has_attr (row, DW_AT_name))
+      {
+	if (m_name_hashes[row] != unknown_hash
+	    && m_name_hashes[row] != hash)
+	  return false;
+      }
+    else if (! integrates)
+      return false;
+
+  return true;
+}
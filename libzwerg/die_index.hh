@@ -0,0 +1,155 @@
+/*
+   Copyright (C) 2026 Petr Machata
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _DIE_INDEX_H_
+#define _DIE_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <elfutils/libdw.h>
+
+class dwfl_context;
+
+// Conditions that a DIE has to meet to be of interest.  A filter is
+// derived from assertions that follow a DIE-producing word, and is
+// used to skip DIE's that certainly wouldn't pass these assertions.
+struct die_filter
+{
+  // DW_TAG_* codes, and whether the DIE has to (true) or must not
+  // (false) have that tag.
+  std::vector <std::pair <int, bool>> m_tags;
+
+  // DW_AT_* codes, and whether the DIE has to (true) or must not
+  // (false) have that attribute.
+  std::vector <std::pair <unsigned, bool>> m_atnames;
+
+  // Values that `name' of the DIE has to be equal to, and their
+  // hashes as computed by die_index::name_hash.
+  std::vector <std::string> m_names;
+  std::vector <uint32_t> m_name_hashes;
+
+  // Offsets that the DIE has to be at.  Units are filtered only by
+  // these, and compare them with offset of the unit header.
+  std::vector <Dwarf_Off> m_offsets;
+
+  void add_name (std::string name);
+  bool empty () const;
+
+  // Whether OFF meets the offset conditions of this filter.
+  bool passes_offset (Dwarf_Off off) const;
+
+  // Whether DIE may pass this filter.  This only looks at DIE's
+  // offset and abbreviation, unless there are names to compare.  COOKED
+  // determines whether to consider attribute integration.  See also
+  // die_index::table::may_pass.
+  bool may_pass (Dwarf_Die &die, bool cooked) const;
+};
+
+// Per-DIE index of a Dwarf file.  For each DIE, it records its
+// offset, offset of its parent, tag, hash of DW_AT_name, and which
+// attributes are present.  This is enough to decide many queries
+// without having to decode .debug_info.
+//
+// Building the index means walking all DIE's, so the index only pays
+// off when it's reused.  It is only used when DWGREP_INDEX_DIR names
+// a directory where the index can be stored.  Next time the same
+// file is opened, the index is memory-mapped from there.  The index
+// is keyed by build ID of the file, and validated against file's
+// size and mtime.
+class die_index
+{
+public:
+  static Dwarf_Off const no_off = (Dwarf_Off) -1;
+
+  // Columns for DIE's of one Dwarf.  Rows are sorted by DIE offset,
+  // which is also the order in which a preorder walk would visit the
+  // DIE's.  Unit DIE's have no parent.
+  class table
+  {
+    friend class die_index;
+
+    Dwarf *m_dw;
+    size_t m_size;
+    uint64_t const *m_offsets;
+    uint64_t const *m_parents;
+    uint64_t const *m_attrs;
+    uint32_t const *m_name_hashes;
+    uint16_t const *m_tags;
+
+    bool has_attr (size_t row, unsigned atname) const;
+
+  public:
+    Dwarf *get_dwarf () const { return m_dw; }
+    size_t size () const { return m_size; }
+
+    // Return row of DIE at OFF, or size () if there's no such DIE.
+    size_t find (Dwarf_Off off) const;
+
+    Dwarf_Off offset (size_t row) const { return m_offsets[row]; }
+    Dwarf_Off parent (size_t row) const { return m_parents[row]; }
+    int tag (size_t row) const { return m_tags[row]; }
+
+    // Whether a DIE at ROW may pass filter FLT.  When this returns
+    // false, DIE certainly doesn't pass.  When it returns true, it
+    // still needs to be checked.  COOKED determines whether to
+    // consider attribute integration.
+    bool may_pass (size_t row, die_filter const &flt, bool cooked) const;
+  };
+
+  // Return an index for the Dwarf files in DWCTX, loading it from
+  // disk, or building it if necessary.  Return nullptr if the index
+  // is not enabled, or can't be used with DWCTX.
+  static std::unique_ptr <die_index> open (dwfl_context &dwctx);
+
+  ~die_index ();
+
+  // Return table for DW, or nullptr if DW is not indexed.
+  table const *find_table (Dwarf *dw) const;
+
+  // Hash of NAME.  This is never unknown_hash, which is what DIE's
+  // whose name can't be read are indexed with.
+  static uint32_t name_hash (char const *name);
+  static uint32_t const unknown_hash = 0;
+
+private:
+  void *m_map;
+  size_t m_map_size;
+  std::vector <uint64_t> m_image;
+  std::vector <table> m_tables;
+
+  die_index ();
+  bool attach (uint64_t const *words, size_t nwords,
+	       std::vector <uint64_t> const &key,
+	       std::vector <Dwarf *> const &dwarfs);
+};
+
+#endif /* _DIE_INDEX_H_ */
@@ -28,23 +28,32 @@
 
 #include "dwfl_context.hh"
 #include "cache.hh"
+#include "die_index.hh"
 #include "dwit.hh"
+#include "dwpp.hh"
 
 struct dwfl_context::pimpl
 {
   parent_cache m_parcache;
-  root_cache m_rootcache;
+  addr_cache m_addrcache;
+  symbol_cache m_symcache;
+  abbrev_cache m_abbrevcache;
+
+  bool m_index_loaded = false;
+  std::unique_ptr <die_index> m_index;
 
   Dwarf_Off
   find_parent (Dwarf_Die die)
   {
-    return m_parcache.find (die);
-  }
+    if (m_index != nullptr)
+      if (auto tab = m_index->find_table (dwarf_cu_getdwarf (die.cu)))
+	{
+	  size_t row = tab->find (dwarf_dieoffset (&die));
+	  if (row != tab->size ())
+	    return tab->parent (row);
+	}
 
-  bool
-  is_root (Dwarf_Die die)
-  {
-    return m_rootcache.is_root (die);
+    return m_parcache.find (die);
   }
 };
 
@@ -59,13 +68,41 @@ dwfl_context::~dwfl_context ()
 Dwarf_Off
 dwfl_context::find_parent (Dwarf_Die die)
 {
+  // The index is only used if it's already loaded.  Looking up a
+  // parent usually only needs to walk one unit, and loading the index
+  // might mean walking all of them.
   return m_pimpl->find_parent (die);
 }
 
+parent_cache &
+dwfl_context::get_parent_cache ()
+{
+  return m_pimpl->m_parcache;
+}
+
+addr_cache &
+dwfl_context::get_addr_cache ()
+{
+  return m_pimpl->m_addrcache;
+}
+
+symbol_cache &
+dwfl_context::get_symbol_cache ()
+{
+  return m_pimpl->m_symcache;
+}
+
+abbrev_cache &
+dwfl_context::get_abbrev_cache ()
+{
+  return m_pimpl->m_abbrevcache;
+}
+
 bool
 dwfl_context::is_root (Dwarf_Die die)
 {
-  return m_pimpl->is_root (die);
+  Dwarf_Die cudie = dwpp_cudie (die);
+  return dwarf_dieoffset (&die) == dwarf_dieoffset (&cudie);
 }
 
 int
@@ -90,3 +127,20 @@ dwfl_context::get_machine () const
   assert (machine != EM_NONE);
   return machine;
 }
+
+die_index const *
+dwfl_context::get_die_index ()
+{
+  if (! m_pimpl->m_index_loaded)
+    {
+      m_pimpl->m_index_loaded = true;
+      m_pimpl->m_index = die_index::open (*this);
+    }
+  return m_pimpl->m_index.get ();
+}
+
+die_index const *
+dwfl_context::loaded_die_index () const
+{
+  return m_pimpl->m_index.get ();
+}
@@ -32,6 +32,12 @@
 #include <memory>
 #include <elfutils/libdwfl.h>
 
+class die_index;
+class parent_cache;
+class addr_cache;
+class symbol_cache;
+class abbrev_cache;
+
 // This represents a Dwfl handle together with some query caches.
 class dwfl_context
 {
@@ -47,8 +53,22 @@ public:
   { return &*m_dwfl; }
 
   Dwarf_Off find_parent (Dwarf_Die die);
+  parent_cache &get_parent_cache ();
+  addr_cache &get_addr_cache ();
+  symbol_cache &get_symbol_cache ();
+  abbrev_cache &get_abbrev_cache ();
   bool is_root (Dwarf_Die die);
   int get_machine () const;
+
+  // Return DIE index for this context, loading it on first call.
+  // Returns nullptr if the index is not available.  Loading may mean
+  // walking and indexing all DIE's, so this should only be called by
+  // those that would walk many DIE's anyway.
+  die_index const *get_die_index ();
+
+  // Return DIE index for this context if it was already loaded by
+  // get_die_index, otherwise nullptr.
+  die_index const *loaded_die_index () const;
 };
 
 #endif /* _DWFL_CONTEXT_H_ */
@@ -380,6 +380,12 @@ all_dies_iterator::parent () const
   return ret;
 }
 
+Dwarf_Off
+all_dies_iterator::parent_offset () const
+{
+  return m_stack.empty () ? (Dwarf_Off) -1 : m_stack.back ();
+}
+
 cu_iterator
 all_dies_iterator::cu () const
 {
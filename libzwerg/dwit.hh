@@ -176,6 +176,10 @@ public:
 
   std::vector<Dwarf_Die> stack () const;
   all_dies_iterator parent () const;
+
+  // Offset of parent of the current DIE, or (Dwarf_Off) -1 for a
+  // unit DIE.
+  Dwarf_Off parent_offset () const;
   cu_iterator cu () const;
 };
 
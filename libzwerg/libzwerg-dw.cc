@@ -30,6 +30,7 @@
 #include "libzwerg-dw.h"
 #include "libzwerg.hh"
 
+#include "atval.hh"
 #include "builtin-dw.hh"
 #include "value-aset.hh"
 #include "value-dw.hh"
@@ -306,6 +307,28 @@ zw_value_dwarf_machine (zw_value const *val, zw_error **out_err)
     }, nullptr, out_err);
 }
 
+namespace
+{
+  bool
+  is_word (tree const &t, char const *name)
+  {
+    return t.tt () == tree_type::READ && t.str () == name;
+  }
+}
+
+bool
+zw_query_splits_by_unit (zw_query const *query)
+{
+  // Applied to a Dwarf, "entry" yields DIE's of one unit after
+  // another, just like "unit entry" would.  Anything after it in the
+  // toplevel CAT only sees those DIE's.  Nothing can be bound before
+  // the first word of a query, so the word refers to the builtin.
+  tree const *t = &query->m_tree;
+  if (t->tt () == tree_type::SCOPE)
+    t = &t->child (0);
+  tree const &head = t->tt () == tree_type::CAT ? t->child (0) : *t;
+  return is_word (head, "entry") && ! query->m_tree.uses_pos ();
+}
 
 namespace
 {
@@ -352,6 +375,66 @@ zw_value_die_dwarf (zw_value const *val, zw_error **out_err)
     }, nullptr, out_err);
 }
 
+namespace
+{
+  template <class T>
+  struct upcast_producer
+    : public value_producer <value>
+  {
+    std::unique_ptr <value_producer <T>> m_vpr;
+
+    explicit upcast_producer (std::unique_ptr <value_producer <T>> vpr)
+      : m_vpr {std::move (vpr)}
+    {}
+
+    std::unique_ptr <value>
+    next () override
+    {
+      return m_vpr->next ();
+    }
+  };
+
+  zw_values *
+  new_values (std::unique_ptr <value_producer <value>> vpr)
+  {
+    return new zw_values {std::move (vpr)};
+  }
+
+  template <class T>
+  zw_values *
+  new_values (std::unique_ptr <value_producer <T>> vpr)
+  {
+    return new_values (std::make_unique <upcast_producer <T>>
+		       (std::move (vpr)));
+  }
+
+  zw_values *
+  die_attributes (zw_value const *val, bool raw, zw_error **out_err)
+  {
+    return capture_errors ([&] () {
+	value_die const &d = die (val);
+	auto a = raw || d.is_raw ()
+	  ? std::make_unique <value_die> (d.get_dwctx (), d.get_die (), 0,
+					  doneness::raw)
+	  : std::make_unique <value_die> (d.get_dwctx (), d.get_import (),
+					  d.get_die (), 0, doneness::cooked);
+	return new_values (make_attribute_producer (std::move (a)));
+      }, nullptr, out_err);
+  }
+}
+
+zw_values *
+zw_value_die_attributes (zw_value const *val, zw_error **out_err)
+{
+  return die_attributes (val, false, out_err);
+}
+
+zw_values *
+zw_value_die_attributes_raw (zw_value const *val, zw_error **out_err)
+{
+  return die_attributes (val, true, out_err);
+}
+
 namespace
 {
   value_attr const &
@@ -376,6 +459,16 @@ zw_value_attr_dwarf (zw_value const *val, zw_error **out_err)
     }, nullptr, out_err);
 }
 
+zw_values *
+zw_value_attr_values (zw_value const *val, zw_error **out_err)
+{
+  return capture_errors ([&] () {
+      value_attr const &a = attr (val);
+      return new_values (at_value (a.get_dwctx (), a.get_value_die (),
+				   a.get_attr ()));
+    }, nullptr, out_err);
+}
+
 
 namespace
 {
@@ -412,6 +505,15 @@ zw_value_llelem_expr (zw_value const *val, size_t *out_length)
   return e.get_expr ();
 }
 
+zw_values *
+zw_value_llelem_ops (zw_value const *val, zw_error **out_err)
+{
+  return capture_errors ([&] () {
+      auto e = std::make_unique <value_loclist_elem> (llelem (val));
+      return new_values (make_elem_loclist_producer (std::move (e), true));
+    }, nullptr, out_err);
+}
+
 
 namespace
 {
@@ -434,6 +536,19 @@ zw_value_llop_op (zw_value const *val)
   return llop (val).get_dwop ();
 }
 
+zw_values *
+zw_value_llop_values (zw_value const *val, zw_error **out_err)
+{
+  return capture_errors ([&] () {
+      value_loclist_op const &o = llop (val);
+      return new_values (std::make_unique <value_producer_cat <value>>
+			 (dwop_number (o.get_dwctx (), o.get_attr (),
+				       o.get_dwop ()),
+			  dwop_number2 (o.get_dwctx (), o.get_attr (),
+					o.get_dwop ())));
+    }, nullptr, out_err);
+}
+
 
 namespace
 {
@@ -181,6 +181,17 @@ extern "C" {
 					    zw_error **out_err);
 
 
+  // Return whether QUERY starts with the word "entry" and does not
+  // use the word "pos".  Running such a query on a stack with a
+  // DWARF value on TOS yields the same stacks, in the same order, as
+  // running it on each unit of that DWARF value in turn (as yielded
+  // by "unit"), with the unit on TOS instead.  The only difference
+  // is in positions of yielded DIE's, which are counted from the
+  // start of each unit.  Units can thus be processed independently,
+  // e.g. in parallel, with each worker using its own DWARF value.
+  bool zw_query_splits_by_unit (zw_query const *query);
+
+
   /**
    * CU.
    */
@@ -232,6 +243,20 @@ extern "C" {
   // *OUT_ERR.  OUT_ERR shall be non-NULL.
   zw_value const *zw_value_die_dwarf (zw_value const *die, zw_error **out_err);
 
+  // Return a producer of attribute values, one for each attribute of
+  // DIE, which shall be a DIE value.  The attributes are the same
+  // that Zwerg word "attribute" would yield, i.e. for cooked DIE's,
+  // that includes attributes integrated through DW_AT_specification
+  // and DW_AT_abstract_origin.  Returns NULL on error, in which case
+  // it sets *OUT_ERR.  OUT_ERR shall be non-NULL.
+  zw_values *zw_value_die_attributes (zw_value const *die,
+				      zw_error **out_err);
+
+  // Like zw_value_die_attributes, but DIE is considered raw, and
+  // only attributes that DIE itself has are produced.
+  zw_values *zw_value_die_attributes_raw (zw_value const *die,
+					  zw_error **out_err);
+
 
   /**
    * DIE attribute.
@@ -251,6 +276,12 @@ extern "C" {
   zw_value const *zw_value_attr_dwarf (zw_value const *attr,
 				       zw_error **out_err);
 
+  // Return a producer of values of ATTR, which shall be an attribute
+  // value.  These are the values that Zwerg word "value" would yield,
+  // and there can be any number of them.  Returns NULL on error, in
+  // which case it sets *OUT_ERR.  OUT_ERR shall be non-NULL.
+  zw_values *zw_value_attr_values (zw_value const *attr, zw_error **out_err);
+
 
   /**
    * Location list element.
@@ -279,6 +310,12 @@ extern "C" {
   // in the returned array.
   Dwarf_Op *zw_value_llelem_expr (zw_value const *llelem, size_t *out_length);
 
+  // Return a producer of location list operation values, one for
+  // each operation of LLELEM, which shall be a location list value.
+  // Returns NULL on error, in which case it sets *OUT_ERR.  OUT_ERR
+  // shall be non-NULL.
+  zw_values *zw_value_llelem_ops (zw_value const *llelem, zw_error **out_err);
+
 
   /**
    * Location list operation.
@@ -296,6 +333,12 @@ extern "C" {
   // operation value, references.
   Dwarf_Op *zw_value_llop_op (zw_value const *llop);
 
+  // Return a producer of operands of LLOP, which shall be a location
+  // list operation value.  These are the values that Zwerg word
+  // "value" would yield.  Returns NULL on error, in which case it
+  // sets *OUT_ERR.  OUT_ERR shall be non-NULL.
+  zw_values *zw_value_llop_values (zw_value const *llop, zw_error **out_err);
+
 
   /**
    * Address sets.
@@ -61,7 +61,7 @@ extern "C" zw_vocabulary *
 zw_vocabulary_init (zw_error **out_err)
 {
   return capture_errors ([&] () {
-      return new zw_vocabulary { std::make_unique <vocabulary> () };
+      return new zw_vocabulary { std::make_shared <vocabulary> () };
     }, nullptr, out_err);
 }
 
@@ -89,7 +89,7 @@ zw_vocabulary_add (zw_vocabulary *voc, zw_vocabulary const *to_add,
   assert (voc->m_voc != nullptr);
   assert (to_add->m_voc != nullptr);
   return capture_errors ([&] () {
-      voc->m_voc = std::make_unique <vocabulary> (*voc->m_voc, *to_add->m_voc);
+      voc->m_voc = std::make_shared <vocabulary> (*voc->m_voc, *to_add->m_voc);
       return true;
     }, false, out_err);
 }
@@ -149,21 +149,118 @@ zw_query_parse (zw_vocabulary const *voc, char const *query,
   return zw_query_parse_len (voc, query, strlen (query), out_err);
 }
 
+zw_query::zw_query (tree t, std::shared_ptr <vocabulary const> voc,
+		    std::shared_ptr <profile> prof)
+  : m_tree {t}
+  , m_voc {voc}
+  , m_profile {prof}
+{
+  // Build the query right away, so that errors in it are reported
+  // when it's parsed.  Statistics are only kept for plans that are
+  // actually executed.
+  auto p = build_plan ({}, nullptr);
+  if (m_profile == nullptr)
+    m_plans[0] = p;
+}
+
+std::shared_ptr <zw_query::plan const>
+zw_query::build_plan (stack_profile const &input,
+		      std::shared_ptr <profile> prof) const
+{
+  auto ret = std::make_shared <plan> ();
+  ret->m_origin = std::make_shared <op_origin> (ret->m_l);
+  ret->m_op = m_tree.build_exec (ret->m_l, ret->m_origin, *m_voc, input,
+				 prof);
+  return ret;
+}
+
+std::shared_ptr <zw_query::plan const>
+zw_query::find_plan (stack const &stk) const
+{
+  std::lock_guard <std::mutex> lock {m_plans_mutex};
+  auto &ret = m_plans[stk.profile ()];
+  if (ret == nullptr)
+    ret = build_plan (selector {stk}.get_types (), m_profile);
+  return ret;
+}
+
+namespace
+{
+  zw_query *
+  new_query (zw_vocabulary const *voc,
+	     char const *query, size_t query_len,
+	     std::shared_ptr <profile> prof, zw_error **out_err)
+  {
+    return capture_errors ([&] () {
+	tree t = parse_query ({query, query_len});
+	t.simplify ();
+	return new zw_query {t, voc->m_voc, prof};
+      }, nullptr, out_err);
+  }
+
+  std::unique_ptr <stack>
+  clone_stack (zw_stack const &input_stack)
+  {
+    auto stk = std::make_unique <stack> ();
+    for (auto const &emt: input_stack.m_values)
+      stk->push (emt->clone ());
+    return stk;
+  }
+}
+
 zw_query *
 zw_query_parse_len (zw_vocabulary const *voc,
 		    char const *query, size_t query_len,
 		    zw_error **out_err)
 {
-  return capture_errors ([&] () {
-      tree t = parse_query ({query, query_len});
-      t.simplify ();
+  return new_query (voc, query, query_len, nullptr, out_err);
+}
+
+zw_query *
+zw_query_parse_profiled (zw_vocabulary const *voc,
+			 char const *query, size_t query_len,
+			 zw_error **out_err)
+{
+  return new_query (voc, query, query_len, std::make_shared <profile> (),
+		    out_err);
+}
 
-      layout l;
-      auto origin = std::make_shared <op_origin> (l);
-      auto op = t.build_exec (l, origin, *voc->m_voc);
+zw_value *
+zw_query_profile (zw_query const *query, zw_error **out_err)
+{
+  assert (query->m_profile != nullptr);
+  std::stringstream ss;
+  query->m_profile->format (ss);
+  std::string const &s = ss.str ();
+  return zw_value_init_str_len (s.c_str (), s.size (), 0, out_err);
+}
 
-      return new zw_query {l, *origin, op};
-    }, nullptr, out_err);
+zw_value *
+zw_query_explain (zw_vocabulary const *voc,
+		  char const *query, size_t query_len,
+		  zw_stack const *input_stack, zw_error **out_err)
+{
+  std::unique_ptr <zw_query> q
+    {new_query (voc, query, query_len, nullptr, out_err)};
+  if (q == nullptr)
+    return nullptr;
+
+  auto prof = std::make_shared <profile> ();
+  bool ok = capture_errors ([&] () {
+      stack_profile input;
+      if (input_stack != nullptr)
+	input = selector {*clone_stack (*input_stack)}.get_types ();
+      q->build_plan (input, prof);
+      return true;
+    }, false, out_err);
+  if (! ok)
+    return nullptr;
+
+  std::stringstream ss;
+  ss << "simplified: " << q->m_tree << "\n";
+  prof->format_plan (ss);
+  std::string const &s = ss.str ();
+  return zw_value_init_str_len (s.c_str (), s.size (), 0, out_err);
 }
 
 void
@@ -200,12 +297,9 @@ zw_query_execute (zw_query const *query, zw_stack const *input_stack,
 		  zw_error **out_err)
 {
   return capture_errors ([&] () {
-      auto stk = std::make_unique <stack> ();
-      for (auto const &emt: input_stack->m_values)
-	stk->push (emt->clone ());
-
-      return new zw_result {query->m_l, query->m_origin, query->m_op,
-			    std::move (stk)};
+      auto stk = clone_stack (*input_stack);
+      auto p = query->find_plan (*stk);
+      return new zw_result {p->m_l, *p->m_origin, p->m_op, std::move (stk)};
     }, nullptr, out_err);
 }
 
@@ -240,6 +334,21 @@ zw_result_destroy (zw_result *result)
   delete result;
 }
 
+bool
+zw_values_next (zw_values *values, zw_value **out_value, zw_error **out_err)
+{
+  return capture_errors ([&] () {
+      *out_value = values->m_vpr->next ().release ();
+      return true;
+    }, false, out_err);
+}
+
+void
+zw_values_destroy (zw_values *values)
+{
+  delete values;
+}
+
 bool
 zw_value_is_const (zw_value const *val)
 {
@@ -292,6 +401,12 @@ zw_value_const_i64 (zw_value const *val)
   return v.sval ();
 }
 
+zw_cdom const *
+zw_value_const_dom (zw_value const *val)
+{
+  return extract_constant (val).dom ();
+}
+
 namespace
 {
   zw_value *
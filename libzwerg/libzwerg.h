@@ -105,6 +105,10 @@ extern "C" {
   // produce individual stacks of values that the query yielded.
   typedef struct zw_result zw_result;
 
+  // zw_values produces a sequence of values, such as attributes of a
+  // DIE.  See e.g. zw_value_die_attributes.
+  typedef struct zw_values zw_values;
+
 
   // Free the resources associated with ERR.
   void zw_error_destroy (zw_error *err);
@@ -196,6 +200,41 @@ extern "C" {
 				char const *query, size_t query_len,
 				zw_error **out_err);
 
+  // Like zw_query_parse_len, but the parts of the query are
+  // instrumented to keep statistics of how they are executed.  This
+  // makes the query slower.  See zw_query_profile.
+  //
+  // Statistics are kept per query, and are not thread-safe.  The
+  // query shall not be executed from several threads at once.
+  zw_query *zw_query_parse_profiled (zw_vocabulary const *voc,
+				     char const *query, size_t query_len,
+				     zw_error **out_err);
+
+  // Format statistics that QUERY collected in all its executions so
+  // far.  The result is a string value with a table that has a row
+  // for each part of the query, children indented below their
+  // parents.  For each part, it shows how many times it was asked for
+  // a value, how many values it produced, how many times it rejected
+  // a value (for assertions), and time spent in it with and without
+  // the nested parts.  Returns NULL on error, in which case it sets
+  // *OUT_ERR.  QUERY shall come from zw_query_parse_profiled.
+  zw_value *zw_query_profile (zw_query const *query, zw_error **out_err);
+
+  // Parse QUERY of length QUERY_LEN and build it as
+  // zw_query_execute would for INPUT_STACK, but instead of running
+  // the query, describe what it was built into.  INPUT_STACK may be
+  // NULL, in which case nothing is assumed about the stacks that the
+  // query would run on.  The result is a string value with the
+  // simplified syntax tree, followed by a table that has a row for
+  // each part of the query, children indented below their parents.
+  // For each part, it shows the op or predicate that implements it,
+  // and how many bytes of execution state it needs.  Returns NULL on
+  // error, in which case it sets *OUT_ERR.
+  zw_value *zw_query_explain (zw_vocabulary const *voc,
+			      char const *query, size_t query_len,
+			      zw_stack const *input_stack,
+			      zw_error **out_err);
+
   // Release resources associated with QUERY.
   void zw_query_destroy (zw_query *query);
 
@@ -203,6 +242,11 @@ extern "C" {
   // which individual resulting stacks can be pulled.  Returns NULL on
   // error, in which case it sets *OUT_ERR.  OUT_ERR shall be
   // non-NULL.
+  //
+  // The first time QUERY is run on a stack with particular types of
+  // values near TOS, it is built anew with those types in mind, which
+  // lets overloaded words skip dispatch by value type.  Later runs on
+  // such stacks reuse that build.
   zw_result *zw_query_execute (zw_query const *query,
 			       zw_stack const *input_stack,
 			       zw_error **out_err);
@@ -217,6 +261,16 @@ extern "C" {
   // Release resources associated with RESULT.
   void zw_result_destroy (zw_result *result);
 
+  // Pull next value from VALUES.  Returns true and sets *OUT_VALUE to
+  // the value, which the caller then owns, or to NULL, if there are
+  // no more values.  Returns false on error, in which case it sets
+  // *OUT_ERR.  OUT_ERR shall be non-NULL.
+  bool zw_values_next (zw_values *values,
+		       zw_value **out_value, zw_error **out_err);
+
+  // Release resources associated with VALUES.
+  void zw_values_destroy (zw_values *values);
+
 
   /**
    * Values.
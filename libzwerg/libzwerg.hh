@@ -62,6 +62,12 @@ struct zw_deleter
   {
     zw_result_destroy (res);
   }
+
+  void
+  operator() (zw_values *vals)
+  {
+    zw_values_destroy (vals);
+  }
 };
 
 struct zw_throw_on_error
@@ -96,4 +102,12 @@ zw_result_next (zw_result &result)
   return std::unique_ptr <zw_stack, zw_deleter> {stk};
 }
 
+inline std::unique_ptr <zw_value, zw_deleter>
+zw_values_next (zw_values &values)
+{
+  zw_value *val;
+  zw_values_next (&values, &val, zw_throw_on_error {});
+  return std::unique_ptr <zw_value, zw_deleter> {val};
+}
+
 #endif
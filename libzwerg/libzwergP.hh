@@ -29,12 +29,16 @@
 #include "libzwerg.h"
 #include "libzwerg-dw.h"
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <iostream>
 
 #include "scon.hh"
 #include "tree.hh"
 #include "op.hh"
+#include "profile.hh"
 
 struct vocabulary;
 
@@ -45,14 +49,49 @@ struct zw_error
 
 struct zw_vocabulary
 {
-  std::unique_ptr <vocabulary> m_voc;
+  // Queries keep the vocabulary that they were parsed with, so that
+  // they can be built again.  See zw_query::find_plan.
+  std::shared_ptr <vocabulary> m_voc;
 };
 
 struct zw_query
 {
-  layout m_l;
-  op_origin &m_origin;
-  std::shared_ptr <op> m_op;
+  // An op built from M_TREE, and what it needs to run.
+  struct plan
+  {
+    layout m_l;
+    std::shared_ptr <op_origin> m_origin;
+    std::shared_ptr <op> m_op;
+  };
+
+  // Simplified tree that the plans are built from.
+  tree m_tree;
+  std::shared_ptr <vocabulary const> m_voc;
+
+  // Statistics of execution of the plans, or nullptr if the query is
+  // not profiled.
+  std::shared_ptr <profile> m_profile;
+
+private:
+  // Plans keyed by profile of the input stack.  Each is built with
+  // types of values near TOS known, so that overloaded words can be
+  // dispatched statically.
+  mutable std::mutex m_plans_mutex;
+  mutable std::map <selector::sel_t, std::shared_ptr <plan const>> m_plans;
+
+public:
+  zw_query (tree t, std::shared_ptr <vocabulary const> voc,
+	    std::shared_ptr <profile> prof);
+
+  // Build a plan for stacks with types INPUT near TOS.  If PROF is
+  // not nullptr, the plan records statistics into it.
+  std::shared_ptr <plan const> build_plan (stack_profile const &input,
+					   std::shared_ptr <profile> prof)
+    const;
+
+  // Return a plan for stacks with the same profile as STK, building
+  // it if necessary.
+  std::shared_ptr <plan const> find_plan (stack const &stk) const;
 };
 
 struct zw_result
@@ -82,6 +121,11 @@ struct zw_stack
   std::vector <std::unique_ptr <zw_value>> m_values;
 };
 
+struct zw_values
+{
+  std::unique_ptr <value_producer <zw_value>> m_vpr;
+};
+
 
 namespace
 {
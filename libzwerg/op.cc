@@ -30,7 +30,6 @@
 #include <iostream>
 #include <sstream>
 #include <memory>
-#include <set>
 #include <algorithm>
 #include "../extern/optional.hpp"
 
@@ -583,25 +582,128 @@ op_capture::name () const
 
 namespace
 {
-  struct deref_less
+  // A set of stacks.  This is a hash table with open addressing and
+  // linear probing, so that looking up a stack rarely needs more than
+  // one full comparison.
+  class stack_set
   {
-    template <class T>
+    struct slot
+    {
+      size_t m_hash;
+      std::shared_ptr <stack> m_stk;
+    };
+
+    // The number of slots is a power of two, and at most half of them
+    // are occupied.
+    std::vector <slot> m_slots;
+
+    // Indices of occupied slots, so that clear doesn't need to visit
+    // all of them.
+    std::vector <size_t> m_used;
+
+    size_t
+    first_index (size_t hash) const
+    {
+      // Stack hashes of DIE's are dominated by DIE offsets, whose low
+      // bits are not very random.  Mix them up.
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      return hash & (m_slots.size () - 1);
+    }
+
+    void
+    put (size_t hash, std::shared_ptr <stack> stk, size_t i)
+    {
+      m_slots[i] = {hash, std::move (stk)};
+      m_used.push_back (i);
+    }
+
+    size_t
+    find_slot (size_t hash, stack const &stk) const
+    {
+      size_t mask = m_slots.size () - 1;
+      size_t i = first_index (hash);
+      for (; m_slots[i].m_stk != nullptr; i = (i + 1) & mask)
+	if (m_slots[i].m_hash == hash && *m_slots[i].m_stk == stk)
+	  break;
+      return i;
+    }
+
+    void
+    grow ()
+    {
+      std::vector <slot> old;
+      old.swap (m_slots);
+      m_slots.resize (std::max (old.size () * 2, (size_t) 16));
+      m_used.clear ();
+
+      for (auto &s: old)
+	if (s.m_stk != nullptr)
+	  put (s.m_hash, std::move (s.m_stk),
+	       find_slot (s.m_hash, *s.m_stk));
+    }
+
+  public:
+    // Add STK to the set, unless the set has a stack equal to STK
+    // already.  Return whether STK was added.
     bool
-    operator() (T const &a, T const &b)
+    insert (std::shared_ptr <stack> stk)
+    {
+      if (2 * (m_used.size () + 1) > m_slots.size ())
+	grow ();
+
+      size_t hash = stk->hash ();
+      size_t i = find_slot (hash, *stk);
+      if (m_slots[i].m_stk != nullptr)
+	return false;
+
+      put (hash, std::move (stk), i);
+      return true;
+    }
+
+    void
+    clear ()
     {
-      return *a < *b;
+      for (size_t i: m_used)
+	m_slots[i].m_stk = nullptr;
+      m_used.clear ();
     }
   };
 }
 
+// One level of a depth-first walk.  Each has its own state of the
+// closed-over op, which is fed the stack whose children it yields.
+struct op_tr_closure::level
+{
+  scon m_scon;
+  scon_guard m_sg;
+
+  level (layout const &l, op &op)
+    : m_scon {l}
+    , m_sg {m_scon, op}
+  {}
+};
+
 struct op_tr_closure::state
 {
-  std::set <std::shared_ptr <stack>, deref_less> m_seen;
+  stack_set m_seen;
   std::vector <std::shared_ptr <stack> > m_stks;
   bool m_op_drained;
 
+  // Levels of a depth-first walk.  The first M_DEPTH of them are in
+  // use, the rest are kept around to be reused.
+  std::vector <std::unique_ptr <level>> m_levels;
+  size_t m_depth;
+
+  // Whether the closure of the current upstream stack may yield the
+  // same stack several times, which then needs to be filtered out.
+  bool m_dedup;
+
   state ()
     : m_op_drained {true}
+    , m_depth {0}
+    , m_dedup {true}
   {}
 
   std::unique_ptr <stack> yield_and_cache (std::shared_ptr <stack> stk);
@@ -616,6 +718,22 @@ op_tr_closure::op_tr_closure (layout &l,
   , m_origin {origin}
   , m_op {op}
   , m_is_plus {k == op_tr_closure_kind::plus}
+  , m_single_word {false}
+  , m_ll {l.reserve <state> ()}
+{}
+
+op_tr_closure::op_tr_closure (layout &l,
+			      std::shared_ptr <op> upstream,
+			      layout op_layout,
+			      std::shared_ptr <op_origin> origin,
+			      std::shared_ptr <op> op,
+			      op_tr_closure_kind k)
+  : inner_op (upstream)
+  , m_origin {origin}
+  , m_op {op}
+  , m_is_plus {k == op_tr_closure_kind::plus}
+  , m_single_word {true}
+  , m_op_layout {op_layout}
   , m_ll {l.reserve <state> ()}
 {}
 
@@ -623,7 +741,8 @@ void
 op_tr_closure::state_con (scon &sc) const
 {
   sc.con <state> (m_ll);
-  m_op->state_con (sc);
+  if (! m_single_word)
+    m_op->state_con (sc);
   inner_op::state_con (sc);
 }
 
@@ -631,14 +750,15 @@ void
 op_tr_closure::state_des (scon &sc) const
 {
   inner_op::state_des (sc);
-  m_op->state_des (sc);
+  if (! m_single_word)
+    m_op->state_des (sc);
   sc.des <state> (m_ll);
 }
 
 std::unique_ptr <stack>
 op_tr_closure::state::yield_and_cache (std::shared_ptr <stack> stk)
 {
-  if (m_seen.insert (stk).second)
+  if (! m_dedup || m_seen.insert (stk))
     {
       m_stks.push_back (stk);
       return std::make_unique <stack> (*stk);
@@ -660,7 +780,10 @@ op_tr_closure::next_from_upstream (state &st, scon &sc) const
   // But if we fail to clear the seen-cache, we only see one.
 
   st.m_seen.clear ();
-  return m_upstream->next (sc);
+  auto stk = m_upstream->next (sc);
+  if (stk != nullptr)
+    st.m_dedup = ! m_single_word || ! m_op->acyclic (*stk);
+  return stk;
 }
 
 stack::uptr
@@ -698,10 +821,58 @@ op_tr_closure::send_to_op (state &st, scon &sc) const
   return true;
 }
 
+void
+op_tr_closure::descend (state &st, std::unique_ptr <stack> stk) const
+{
+  if (st.m_depth == st.m_levels.size ())
+    st.m_levels.push_back (std::make_unique <level> (m_op_layout, *m_op));
+  m_origin->set_next (st.m_levels[st.m_depth++]->m_scon, std::move (stk));
+}
+
+stack::uptr
+op_tr_closure::next_walk (state &st, scon &sc) const
+{
+  while (true)
+    {
+      while (st.m_depth > 0)
+	{
+	  std::shared_ptr <stack> stk
+	    = m_op->next (st.m_levels[st.m_depth - 1]->m_scon);
+	  if (stk == nullptr)
+	    // A level is only left once it's drained, so it can be
+	    // fed the next stack as it is.
+	    --st.m_depth;
+	  else if (! st.m_dedup || st.m_seen.insert (stk))
+	    {
+	      auto ret = std::make_unique <stack> (*stk);
+	      descend (st, std::make_unique <stack> (*stk));
+	      return ret;
+	    }
+	}
+
+      auto stk = next_from_upstream (st, sc);
+      if (stk == nullptr)
+	return nullptr;
+
+      if (m_is_plus)
+	descend (st, std::move (stk));
+      else
+	{
+	  std::shared_ptr <stack> cp = std::move (stk);
+	  if (st.m_dedup)
+	    st.m_seen.insert (cp);
+	  descend (st, std::make_unique <stack> (*cp));
+	  return std::make_unique <stack> (*cp);
+	}
+    }
+}
+
 stack::uptr
 op_tr_closure::next (scon &sc) const
 {
   state &st = sc.get <state> (m_ll);
+  if (m_single_word)
+    return next_walk (st, sc);
 
   do
     while (std::shared_ptr <stack> stk = next_from_op (st, sc))
@@ -1070,6 +1241,20 @@ op_drop_below::name () const
   return ss.str ();
 }
 
+void
+op_drop_below::stack_effect (stack_profile &profile, unsigned drop)
+{
+  if (profile.size () <= drop)
+    {
+      profile.clear ();
+      return;
+    }
+
+  auto tos = profile.back ();
+  profile.erase (profile.end () - drop - 1, profile.end ());
+  profile.push_back (tos);
+}
+
 
 pred_result
 pred_not::result (scon &sc, stack &stk) const
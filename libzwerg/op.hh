@@ -34,6 +34,7 @@
 #include <cassert>
 #include <string>
 
+#include "builtin.hh"
 #include "stack.hh"
 #include "pred_result.hh"
 #include "layout.hh"
@@ -55,6 +56,13 @@ public:
 
   // Produce next value.
   virtual stack::uptr next (scon &sc) const = 0;
+
+  // Whether applying this op repeatedly, starting with STK and
+  // feeding it its own results, can never yield the same stack
+  // twice.  Closures of such ops don't need to remember what stacks
+  // they have seen.  Only asked about ops that feed directly from an
+  // origin.
+  virtual bool acyclic (stack &stk) const { return false; }
 };
 
 template <class RT>
@@ -436,9 +444,12 @@ class op_tr_closure
   : public inner_op
 {
   struct state;
+  struct level;
   std::shared_ptr <op_origin> m_origin;
   std::shared_ptr <op> m_op;
   bool m_is_plus;
+  bool m_single_word;
+  layout m_op_layout;
   layout::loc m_ll;
 
   stack::uptr next_from_op (state &st, scon &sc) const;
@@ -446,9 +457,27 @@ class op_tr_closure
   bool send_to_op (state &st, scon &sc, std::unique_ptr <stack> stk) const;
   bool send_to_op (state &st, scon &sc) const;
 
+  void descend (state &st, std::unique_ptr <stack> stk) const;
+  stack::uptr next_walk (state &st, scon &sc) const;
+
 public:
+  // OP is built in L.  Stacks that it yields are queued up, and OP is
+  // applied to them once it has yielded all it has.
+  op_tr_closure (layout &l,
+		 std::shared_ptr <op> upstream,
+		 std::shared_ptr <op_origin> origin,
+		 std::shared_ptr <op> op,
+		 op_tr_closure_kind k);
+
+  // OP was built from a single word in its own layout OP_LAYOUT, and
+  // feeds directly from ORIGIN.  The closure then walks what OP
+  // yields depth-first, with a separate state of OP for each level
+  // of depth, so it only holds the stacks on the current path.  If
+  // OP claims to be acyclic for a given upstream stack, the closure
+  // doesn't deduplicate what it yields either.
   op_tr_closure (layout &l,
 		 std::shared_ptr <op> upstream,
+		 layout op_layout,
 		 std::shared_ptr <op_origin> origin,
 		 std::shared_ptr <op> op,
 		 op_tr_closure_kind k);
@@ -600,6 +629,7 @@ public:
   std::string name () const override;
   stack::uptr next (scon &sc) const override;
   static std::string docstring () { return "internal"; }
+  static void stack_effect (stack_profile &profile, unsigned drop);
 };
 
 
@@ -27,6 +27,7 @@
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
 
+#include <cstdint>
 #include <memory>
 #include <algorithm>
 #include <iterator>
@@ -35,11 +36,43 @@
 #include "docstring.hh"
 #include "../extern/optional.hpp"
 
+overload_dispatch::overload_dispatch (std::vector <selector> selectors)
+  : m_selectors (std::move (selectors))
+{
+  assert (m_selectors.size () <= UINT16_MAX);
+  for (unsigned code = 0; code <= UINT8_MAX; ++code)
+    {
+      m_tos_start.push_back (m_by_tos.size ());
+      for (size_t i = 0; i < m_selectors.size (); ++i)
+	{
+	  auto tos = m_selectors[i].tos_code ();
+	  if (tos == 0 || tos == code)
+	    m_by_tos.push_back (i);
+	}
+    }
+  m_tos_start.push_back (m_by_tos.size ());
+}
+
+ssize_t
+overload_dispatch::find (stack const &stk) const
+{
+  selector profile {stk};
+  uint8_t code = stk.profile () & 0xff;
+  for (size_t i = m_tos_start[code]; i < m_tos_start[code + 1]; ++i)
+    if (m_selectors[m_by_tos[i]].matches (profile))
+      return m_by_tos[i];
+  return -1;
+}
+
 overload_instance::overload_instance
 	(layout &l,
 	 std::vector <std::tuple <selector,
-				  std::shared_ptr <builtin>>> const &stencil)
+				  std::shared_ptr <builtin>>> const &stencil,
+	 std::shared_ptr <overload_dispatch const> dispatch)
+  : m_dispatch {dispatch}
 {
+  assert (m_dispatch->get_selectors ().size () == stencil.size ());
+
   std::vector <layout> subls;
   for (auto const &v: stencil)
     {
@@ -53,7 +86,6 @@ overload_instance::overload_instance
       if (op == nullptr)
 	origin = nullptr;
 
-      m_selectors.push_back (std::get <0> (v));
       m_execs.push_back (std::make_pair (origin, op));
       m_preds.push_back (std::move (pred));
 
@@ -65,23 +97,35 @@ overload_instance::overload_instance
 
 namespace
 {
-  ssize_t
-  find_selector (selector profile, std::vector <selector> const &selectors)
+  enum class static_match
+    {
+      no,
+      maybe,
+      yes,
+    };
+
+  // Whether stacks with types PROFILE near TOS match SEL.  Slots
+  // that SEL doesn't look at match anything.
+  static_match
+  match_statically (selector const &sel, stack_profile const &profile)
   {
-    auto it = std::find_if (selectors.begin (), selectors.end (),
-			    [profile] (selector const &sel)
-			    { return sel.matches (profile); });
-    if (it == selectors.end ())
-      return -1;
-    else
-      return it - selectors.begin ();
+    auto ret = static_match::yes;
+    for (size_t depth = 0; depth < selector::W; ++depth)
+      if (uint8_t code = sel.code_at (depth))
+	{
+	  if (depth >= profile.size ())
+	    ret = static_match::maybe;
+	  else if (code != profile[profile.size () - 1 - depth].code ())
+	    return static_match::no;
+	}
+    return ret;
   }
 }
 
 std::pair <op_origin *, op *>
 overload_instance::find_exec (stack &stk) const
 {
-  ssize_t idx = find_selector (selector {stk}, m_selectors);
+  ssize_t idx = m_dispatch->find (stk);
   if (idx < 0)
     return {nullptr, nullptr};
   else
@@ -92,7 +136,7 @@ overload_instance::find_exec (stack &stk) const
 std::shared_ptr <pred>
 overload_instance::find_pred (stack &stk) const
 {
-  ssize_t idx = find_selector (selector {stk}, m_selectors);
+  ssize_t idx = m_dispatch->find (stk);
   if (idx < 0)
     return nullptr;
   else
@@ -129,7 +173,7 @@ show_expects (std::string const &name, std::vector <selector> selectors,
 void
 overload_instance::show_error (std::string const &name, selector profile) const
 {
-  return show_expects (name, m_selectors, profile);
+  return show_expects (name, m_dispatch->get_selectors (), profile);
 }
 
 overload_tab::overload_tab (overload_tab const &a, overload_tab const &b)
@@ -147,12 +191,44 @@ overload_tab::add_overload (selector sel, std::shared_ptr <builtin> b)
     assert (std::get <0> (ovl) != sel);
 
   m_overloads.push_back (std::make_tuple (sel, b));
+  m_dispatch = nullptr;
 }
 
 overload_instance
 overload_tab::instantiate (layout &l)
 {
-  return overload_instance {l, m_overloads};
+  // Queries that share a vocabulary may be built concurrently.  Two
+  // threads may both build the dispatch, which is harmless.
+  auto dispatch = std::atomic_load (&m_dispatch);
+  if (dispatch == nullptr)
+    {
+      std::vector <selector> selectors;
+      for (auto const &ovl: m_overloads)
+	selectors.push_back (std::get <0> (ovl));
+      dispatch = std::make_shared <overload_dispatch const> (selectors);
+      std::atomic_store (&m_dispatch, dispatch);
+    }
+
+  return overload_instance {l, m_overloads, dispatch};
+}
+
+std::shared_ptr <builtin>
+overload_tab::find_overload (stack_profile const &profile) const
+{
+  // Overloads are tried in order, so an earlier overload that might
+  // match makes it impossible to tell.
+  for (auto const &ovl: m_overloads)
+    switch (match_statically (std::get <0> (ovl), profile))
+      {
+      case static_match::no:
+	continue;
+      case static_match::maybe:
+	return nullptr;
+      case static_match::yes:
+	return std::get <1> (ovl);
+      }
+
+  return nullptr;
 }
 
 
@@ -212,6 +288,13 @@ overload_op::next (scon &sc) const
     }
 }
 
+bool
+overload_op::acyclic (stack &stk) const
+{
+  auto ovl = m_ovl_inst.find_exec (stk);
+  return std::get <1> (ovl) != nullptr && std::get <1> (ovl)->acyclic (stk);
+}
+
 
 pred_result
 overload_pred::result (scon &sc, stack &stk) const
@@ -268,6 +351,32 @@ overloaded_builtin::docstring () const
   return format_entry_map (doc_deduplicate (entries), '.');
 }
 
+void
+overloaded_builtin::stack_effect (stack_profile &profile) const
+{
+  if (auto ovl = m_ovl_tab->find_overload (profile))
+    {
+      ovl->stack_effect (profile);
+      return;
+    }
+
+  bool seen = false;
+  stack_profile ret;
+  for (auto const &ovl: m_ovl_tab->get_overloads ())
+    if (match_statically (std::get <0> (ovl), profile) != static_match::no)
+      {
+	stack_profile after = profile;
+	std::get <1> (ovl)->stack_effect (after);
+	if (! seen)
+	  ret = std::move (after);
+	else
+	  merge_profile (ret, after);
+	seen = true;
+      }
+
+  profile = std::move (ret);
+}
+
 std::shared_ptr <op>
 overloaded_op_builtin::build_exec (layout &l,
 				   std::shared_ptr <op> upstream) const
@@ -276,6 +385,12 @@ overloaded_op_builtin::build_exec (layout &l,
     (l, upstream, get_overload_tab ()->instantiate (l), name ());
 }
 
+std::shared_ptr <builtin const>
+overloaded_op_builtin::peg (stack_profile const &profile) const
+{
+  return get_overload_tab ()->find_overload (profile);
+}
+
 std::shared_ptr <overloaded_builtin>
 overloaded_op_builtin::create_merged (std::shared_ptr <overload_tab> tab) const
 {
@@ -310,6 +425,48 @@ overloaded_pred_builtin::build_pred (layout &l) const
 		       m_positive);
 }
 
+namespace
+{
+  // An overload of a word such as !TAG_*, which negates what the
+  // overload answers.
+  struct negated_overload
+    : public builtin
+  {
+    std::shared_ptr <builtin const> m_bi;
+
+    explicit negated_overload (std::shared_ptr <builtin const> bi)
+      : m_bi {bi}
+    {}
+
+    std::unique_ptr <pred>
+    build_pred (layout &l) const override
+    {
+      return maybe_invert (m_bi->build_pred (l), false);
+    }
+
+    char const *
+    name () const override
+    {
+      return m_bi->name ();
+    }
+
+    builtin_protomap
+    protomap () const override
+    {
+      return m_bi->protomap ();
+    }
+  };
+}
+
+std::shared_ptr <builtin const>
+overloaded_pred_builtin::peg (stack_profile const &profile) const
+{
+  auto ovl = get_overload_tab ()->find_overload (profile);
+  if (ovl == nullptr || m_positive)
+    return ovl;
+  return std::make_shared <negated_overload> (ovl);
+}
+
 std::shared_ptr <overloaded_builtin>
 overloaded_pred_builtin::create_merged
 	(std::shared_ptr <overload_tab> tab) const
@@ -64,18 +64,46 @@
 //
 // For example of this in action, see e.g. operator length.
 
-class overload_instance
+// Decides which of a list of selectors a stack is dispatched to.
+// The first selector that matches the stack is picked.
+class overload_dispatch
 {
   std::vector <selector> m_selectors;
+
+  // Selectors that a stack may be dispatched to, keyed by code of the
+  // type at TOS.  For TOS code C, these are the indices into
+  // m_selectors stored in m_by_tos[m_tos_start[C]] through
+  // m_by_tos[m_tos_start[C + 1] - 1], in order of m_selectors.  For
+  // words whose overloads only look at TOS, there's at most one of
+  // them, and dispatch is a single lookup.
+  std::vector <uint16_t> m_tos_start;
+  std::vector <uint16_t> m_by_tos;
+
+public:
+  explicit overload_dispatch (std::vector <selector> selectors);
+
+  std::vector <selector> const &get_selectors () const
+  { return m_selectors; }
+
+  // Return index of the selector that STK is dispatched to, or -1 if
+  // none matches.
+  ssize_t find (stack const &stk) const;
+};
+
+class overload_instance
+{
+  std::shared_ptr <overload_dispatch const> m_dispatch;
   std::vector <std::pair <std::shared_ptr <op_origin>,
 			  std::shared_ptr <op>>> m_execs;
   std::vector <std::shared_ptr <pred>> m_preds;
 
 public:
+  // DISPATCH shall have been created from selectors of STENCIL.
   overload_instance (layout &l,
 		     std::vector
 			<std::tuple <selector,
-				     std::shared_ptr <builtin>>> const &stencil);
+				     std::shared_ptr <builtin>>> const &stencil,
+		     std::shared_ptr <overload_dispatch const> dispatch);
 
   std::pair <op_origin *, op *> find_exec (stack &stk) const;
   std::shared_ptr <pred> find_pred (stack &stk) const;
@@ -91,6 +119,10 @@ struct overload_tab
 private:
   overload_vec m_overloads;
 
+  // Dispatch among M_OVERLOADS, shared by all instances.  It's built
+  // on first instantiation, and dropped when an overload is added.
+  std::shared_ptr <overload_dispatch const> m_dispatch;
+
 public:
   overload_tab () = default;
   overload_tab (overload_tab const &that) = default;
@@ -103,6 +135,12 @@ public:
 
   overload_instance instantiate (layout &l);
   overload_vec const &get_overloads () const { return m_overloads; }
+
+  // Return the overload that stacks with types PROFILE near TOS
+  // would be dispatched to, if that is known statically.  Otherwise
+  // return nullptr.
+  std::shared_ptr <builtin> find_overload (stack_profile const &profile)
+    const;
 };
 
 class overload_op
@@ -120,6 +158,7 @@ public:
   void state_con (scon &sc) const override;
   void state_des (scon &sc) const override;
   stack::uptr next (scon &sc) const override final;
+  bool acyclic (stack &stk) const override;
 };
 
 class overload_pred
@@ -160,6 +199,11 @@ public:
 
   std::string docstring () const override final;
 
+  // If the overload is known statically, this is its stack effect.
+  // Otherwise it is what all overloads that might be picked agree
+  // on.
+  void stack_effect (stack_profile &profile) const override final;
+
   virtual std::shared_ptr <overloaded_builtin>
   create_merged (std::shared_ptr <overload_tab> tab) const = 0;
 };
@@ -173,6 +217,9 @@ struct overloaded_op_builtin
   std::shared_ptr <op> build_exec (layout &l, std::shared_ptr <op> upstream)
     const override final;
 
+  std::shared_ptr <builtin const> peg (stack_profile const &profile)
+    const override final;
+
   std::shared_ptr <overloaded_builtin>
   create_merged (std::shared_ptr <overload_tab> tab) const override final;
 };
@@ -191,6 +238,9 @@ struct overloaded_pred_builtin
 
   std::unique_ptr <pred> build_pred (layout &l) const override final;
 
+  std::shared_ptr <builtin const> peg (stack_profile const &profile)
+    const override final;
+
   std::shared_ptr <overloaded_builtin>
   create_merged (std::shared_ptr <overload_tab> tab) const override final;
 };
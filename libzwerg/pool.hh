@@ -0,0 +1,209 @@
+/*
+   Copyright (C) 2026 Petr Machata
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <cstddef>
+#include <new>
+
+// Free list of memory blocks of SIZE bytes.  Blocks come from the
+// global operator new, and when freed, they are kept for reuse
+// instead of being returned.  Each thread has its own free list.  A
+// block may be freed on a different thread than it was allocated on,
+// it then simply moves to the other thread's list.
+template <size_t Size>
+class block_pool
+{
+  struct block
+  {
+    block *m_next;
+  };
+
+  static_assert (Size >= sizeof (block), "Block too small.");
+
+  // The free list doesn't grow beyond this many blocks.
+  static size_t const max_count = 4096;
+
+  // This is trivially destructible, and thus usable throughout the
+  // lifetime of the thread, including destruction of other objects
+  // after the reaper has run.
+  struct state
+  {
+    block *m_free;
+    size_t m_count;
+  };
+
+  // Releases the free list when the thread exits.  Blocks freed after
+  // that are returned to the global heap directly.
+  struct reaper
+  {
+    ~reaper ()
+    {
+      state &st = get_state ();
+      while (st.m_free != nullptr)
+	{
+	  block *b = st.m_free;
+	  st.m_free = b->m_next;
+	  ::operator delete (b);
+	}
+      st.m_count = max_count;
+    }
+  };
+
+  static state &
+  get_state ()
+  {
+    thread_local state st {nullptr, 0};
+    return st;
+  }
+
+public:
+  static void *
+  allocate ()
+  {
+    state &st = get_state ();
+    if (block *b = st.m_free)
+      {
+	st.m_free = b->m_next;
+	--st.m_count;
+	return b;
+      }
+
+    return ::operator new (Size);
+  }
+
+  static void
+  deallocate (void *ptr)
+  {
+    // Blocks only ever get to the free list through here.
+    thread_local reaper r;
+    (void) r;
+
+    state &st = get_state ();
+    if (st.m_count >= max_count)
+      {
+	::operator delete (ptr);
+	return;
+      }
+
+    block *b = static_cast <block *> (ptr);
+    b->m_next = st.m_free;
+    st.m_free = b;
+    ++st.m_count;
+  }
+};
+
+// Objects of a class T that derives from pooled <T> are allocated from
+// a block_pool.  Use this for classes that are allocated and freed at
+// high rates, such as stacks and the common value types.  Objects of
+// classes derived from T that are larger than T come from the global
+// heap as usual.
+template <class T>
+struct pooled
+{
+  static void *
+  operator new (size_t size)
+  {
+    if (size == sizeof (T))
+      return block_pool <sizeof (T)>::allocate ();
+    return ::operator new (size);
+  }
+
+  static void
+  operator delete (void *ptr, size_t size)
+  {
+    if (size == sizeof (T))
+      block_pool <sizeof (T)>::deallocate (ptr);
+    else
+      ::operator delete (ptr);
+  }
+};
+
+// Allocator for containers of short sequences.  Storage for up to
+// four elements comes from block_pool's, anything longer from the
+// global heap.
+template <class T>
+struct pool_allocator
+{
+  typedef T value_type;
+
+  pool_allocator () = default;
+
+  template <class U>
+  pool_allocator (pool_allocator <U> const &)
+  {}
+
+  T *
+  allocate (size_t n)
+  {
+    switch (n)
+      {
+      case 1:
+	return static_cast <T *> (block_pool <sizeof (T)>::allocate ());
+      case 2:
+	return static_cast <T *> (block_pool <2 * sizeof (T)>::allocate ());
+      case 3:
+      case 4:
+	return static_cast <T *> (block_pool <4 * sizeof (T)>::allocate ());
+      }
+    return static_cast <T *> (::operator new (n * sizeof (T)));
+  }
+
+  void
+  deallocate (T *ptr, size_t n)
+  {
+    switch (n)
+      {
+      case 1:
+	return block_pool <sizeof (T)>::deallocate (ptr);
+      case 2:
+	return block_pool <2 * sizeof (T)>::deallocate (ptr);
+      case 3:
+      case 4:
+	return block_pool <4 * sizeof (T)>::deallocate (ptr);
+      }
+    ::operator delete (ptr);
+  }
+
+  template <class U>
+  bool
+  operator== (pool_allocator <U> const &) const
+  {
+    return true;
+  }
+
+  template <class U>
+  bool
+  operator!= (pool_allocator <U> const &) const
+  {
+    return false;
+  }
+};
+
+#endif /* _POOL_H_ */
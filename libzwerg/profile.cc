@@ -0,0 +1,202 @@
+/*
+   Copyright (C) 2014 Red Hat, Inc.
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+
+#include "flag_saver.hh"
+#include "profile.hh"
+
+profile::node::node (std::string label, bool is_pred)
+  : m_label {label}
+  , m_is_pred {is_pred}
+  , m_calls {0}
+  , m_yields {0}
+  , m_rejects {0}
+  , m_incl {0}
+  , m_self {0}
+  , m_state {0}
+{}
+
+profile::timer::timer (profile &prof, node &n)
+  : m_prof (prof)
+  , m_node (n)
+  , m_outer_nested {prof.m_nested}
+  , m_start {std::chrono::steady_clock::now ()}
+{
+  m_prof.m_nested = duration {0};
+}
+
+profile::timer::~timer ()
+{
+  duration d = std::chrono::steady_clock::now () - m_start;
+  m_node.m_incl += d;
+  m_node.m_self += d - m_prof.m_nested;
+  m_prof.m_nested = m_outer_nested + d;
+}
+
+profile::profile ()
+  : m_root {"query", false}
+  , m_open {&m_root}
+  , m_nested {0}
+{}
+
+profile::node &
+profile::add (std::string label, bool is_pred)
+{
+  auto &children = m_open.back ()->m_children;
+  children.push_back (std::make_unique <node> (label, is_pred));
+  return *children.back ();
+}
+
+profile::node &
+profile::open (std::string label, bool is_pred)
+{
+  node &ret = add (label, is_pred);
+  m_open.push_back (&ret);
+  return ret;
+}
+
+void
+profile::close ()
+{
+  assert (m_open.size () > 1);
+  m_open.pop_back ();
+}
+
+namespace
+{
+  void
+  format_node (std::ostream &os, profile::node const &n, size_t depth)
+  {
+    auto ms = [] (profile::duration d)
+      {
+	return std::chrono::duration <double, std::milli> (d).count ();
+      };
+
+    os << std::setw (10) << n.m_calls << std::setw (10) << n.m_yields;
+    if (n.m_is_pred)
+      os << std::setw (10) << n.m_rejects;
+    else
+      os << std::setw (10) << "-";
+    os << std::setw (12) << ms (n.m_incl) << std::setw (12) << ms (n.m_self)
+       << "  " << std::string (2 * depth, ' ') << n.m_label << '\n';
+
+    for (auto const &child: n.m_children)
+      format_node (os, *child, depth + 1);
+  }
+
+  void
+  format_plan_node (std::ostream &os, profile::node const &n, size_t depth)
+  {
+    os << std::setw (10) << n.m_state << "  "
+       << std::string (2 * depth, ' ') << n.m_label;
+    if (n.m_op != "")
+      os << "  =>  " << n.m_op;
+    os << '\n';
+
+    for (auto const &child: n.m_children)
+      format_plan_node (os, *child, depth + 1);
+  }
+}
+
+void
+profile::format (std::ostream &os) const
+{
+  ios_flag_saver fs {os};
+  os << std::fixed << std::setprecision (3)
+     << std::setw (10) << "calls" << std::setw (10) << "yields"
+     << std::setw (10) << "rejects" << std::setw (12) << "incl ms"
+     << std::setw (12) << "self ms" << "  expr\n";
+  format_node (os, m_root, 0);
+}
+
+void
+profile::format_plan (std::ostream &os) const
+{
+  ios_flag_saver fs {os};
+  os << std::setw (10) << "state" << "  expr  =>  op\n";
+  format_plan_node (os, m_root, 0);
+}
+
+
+std::string
+op_profile::name () const
+{
+  return m_op->name ();
+}
+
+void
+op_profile::state_con (scon &sc) const
+{
+  m_op->state_con (sc);
+}
+
+void
+op_profile::state_des (scon &sc) const
+{
+  m_op->state_des (sc);
+}
+
+stack::uptr
+op_profile::next (scon &sc) const
+{
+  profile::timer t {*m_prof, m_node};
+  ++m_node.m_calls;
+  auto ret = m_op->next (sc);
+  if (ret != nullptr)
+    ++m_node.m_yields;
+  return ret;
+}
+
+bool
+op_profile::acyclic (stack &stk) const
+{
+  return m_op->acyclic (stk);
+}
+
+
+pred_result
+pred_profile::result (scon &sc, stack &stk) const
+{
+  profile::timer t {*m_prof, m_node};
+  ++m_node.m_calls;
+  pred_result ret = m_pred->result (sc, stk);
+  if (ret == pred_result::yes)
+    ++m_node.m_yields;
+  else
+    ++m_node.m_rejects;
+  return ret;
+}
+
+std::string
+pred_profile::name () const
+{
+  return m_pred->name ();
+}
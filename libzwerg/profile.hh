@@ -0,0 +1,173 @@
+/*
+   Copyright (C) 2014 Red Hat, Inc.
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "op.hh"
+
+// Execution statistics of a query.  When a query is built for
+// profiling (see tree::build_exec), parts of the query are wrapped in
+// op_profile and pred_profile, which record how they are used into a
+// tree of nodes that mirrors the structure of the query.
+//
+// The statistics are not thread-safe.  A profiled query shall not be
+// executed from several threads at once.
+class profile
+{
+public:
+  using duration = std::chrono::steady_clock::duration;
+
+  struct node
+  {
+    std::string m_label;
+    bool m_is_pred;
+
+    // For op's, how many times next() was called, and how many times
+    // it produced a stack.  For pred's, how many times result() was
+    // called, how many times the pred held, and how many times it
+    // didn't (or failed).
+    uint64_t m_calls;
+    uint64_t m_yields;
+    uint64_t m_rejects;
+
+    // Time spent in this part of the query, including (M_INCL) and
+    // excluding (M_SELF) time spent in other profiled parts that it
+    // called.  Op's pull stacks from their upstream, so inclusive
+    // time of an op covers the upstream as well.
+    duration m_incl;
+    duration m_self;
+
+    // Name of the op or pred that this part of the query was built
+    // into, and how many bytes of execution state were reserved for
+    // it and the nested parts.  See profile::format_plan.
+    std::string m_op;
+    size_t m_state;
+
+    std::vector <std::unique_ptr <node>> m_children;
+
+    node (std::string label, bool is_pred);
+  };
+
+  // Measures one call of a profiled op or pred.
+  class timer
+  {
+    profile &m_prof;
+    node &m_node;
+    duration m_outer_nested;
+    std::chrono::steady_clock::time_point m_start;
+
+  public:
+    timer (profile &prof, node &n);
+    ~timer ();
+  };
+
+private:
+  node m_root;
+  std::vector <node *> m_open;
+
+  // Time spent in profiled calls nested in the current one.
+  duration m_nested;
+
+public:
+  profile ();
+
+  // Add a new node as the last child of the innermost open node.
+  node &add (std::string label, bool is_pred);
+
+  // Like add, but until the matching close, further nodes are added
+  // as children of the new one.
+  node &open (std::string label, bool is_pred);
+  void close ();
+
+  node &root () { return m_root; }
+
+  // Show the statistics as a table with one row per node.  Children
+  // are indented below their parents.
+  void format (std::ostream &os) const;
+
+  // Like format, but instead of the statistics, show for each node
+  // the op that it was built into and the size of its state.  This
+  // doesn't need the query to be executed.
+  void format_plan (std::ostream &os) const;
+};
+
+class op_profile
+  : public op
+{
+  std::shared_ptr <op> m_op;
+  std::shared_ptr <profile> m_prof;
+  profile::node &m_node;
+
+public:
+  op_profile (std::shared_ptr <op> op, std::shared_ptr <profile> prof,
+	      profile::node &n)
+    : m_op {op}
+    , m_prof {prof}
+    , m_node (n)
+  {
+    m_node.m_op = m_op->name ();
+  }
+
+  std::string name () const override;
+  void state_con (scon &sc) const override;
+  void state_des (scon &sc) const override;
+  stack::uptr next (scon &sc) const override;
+  bool acyclic (stack &stk) const override;
+};
+
+class pred_profile
+  : public pred
+{
+  std::unique_ptr <pred> m_pred;
+  std::shared_ptr <profile> m_prof;
+  profile::node &m_node;
+
+public:
+  pred_profile (std::unique_ptr <pred> p, std::shared_ptr <profile> prof,
+		profile::node &n)
+    : m_pred {std::move (p)}
+    , m_prof {prof}
+    , m_node (n)
+  {
+    m_node.m_op = m_pred->name ();
+  }
+
+  pred_result result (scon &sc, stack &stk) const override;
+  std::string name () const override;
+};
+
+#endif /* _PROFILE_H_ */
@@ -109,6 +109,22 @@ public:
 
   std::vector <value_type> get_types () const;
 
+  // Code of the type that this selector expects DEPTH slots below
+  // TOS, or 0 if the selector doesn't look at that slot at all.
+  uint8_t
+  code_at (size_t depth) const
+  {
+    return ((m_imprint & m_mask) >> (8 * depth)) & 0xff;
+  }
+
+  // Code of the type that this selector expects at TOS, or 0 if the
+  // selector doesn't look at TOS at all.
+  uint8_t
+  tos_code () const
+  {
+    return code_at (0);
+  }
+
   bool operator< (selector const &that) const
   { return m_imprint < that.m_imprint; }
   bool operator== (selector const &that) const
@@ -30,18 +30,10 @@
 #include "stack.hh"
 #include "value-closure.hh"
 
-stack::stack (stack const &that)
-  : m_profile {that.m_profile}
-{
-  for (auto const &v: that.m_values)
-    m_values.push_back (v->clone ());
-}
-
 namespace
 {
   int
-  compare_stack (std::vector <std::unique_ptr <value> > const &a,
-	       std::vector <std::unique_ptr <value> > const &b)
+  compare_stack (stack::values_t const &a, stack::values_t const &b)
   {
     if (a.size () < b.size ())
       return -1;
@@ -54,9 +46,9 @@ namespace
       auto it = a.begin ();
       auto jt = b.begin ();
       for (; it != a.end (); ++it, ++jt)
-	if (*it == nullptr && *jt != nullptr)
+	if (it->get () == nullptr && jt->get () != nullptr)
 	  return -1;
-	else if (*it != nullptr && *jt == nullptr)
+	else if (it->get () != nullptr && jt->get () == nullptr)
 	  return 1;
     }
 
@@ -65,7 +57,7 @@ namespace
       auto it = a.begin ();
       auto jt = b.begin ();
       for (; it != a.end (); ++it, ++jt)
-	if (*it != nullptr && *jt != nullptr)
+	if (it->get () != nullptr && jt->get () != nullptr)
 	  {
 	    if ((*it)->get_type () < (*jt)->get_type ())
 	      return -1;
@@ -80,7 +72,7 @@ namespace
       auto it = a.begin ();
       auto jt = b.begin ();
       for (; it != a.end (); ++it, ++jt)
-	if (*it != nullptr && *jt != nullptr)
+	if (it->get () != nullptr && jt->get () != nullptr)
 	  switch ((*it)->cmp (**jt))
 	    {
 	    case cmp_result::fail:
@@ -111,3 +103,13 @@ stack::operator== (stack const &that) const
 {
   return compare_stack (m_values, that.m_values) == 0;
 }
+
+size_t
+stack::hash () const
+{
+  size_t ret = m_values.size ();
+  for (auto const &v: m_values)
+    ret = hash_combine (ret, hash_combine (v->get_type ().code (),
+					   v->hash ()));
+  return ret;
+}
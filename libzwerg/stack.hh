@@ -30,20 +30,92 @@
 #ifndef _STK_H_
 #define _STK_H_
 
+#include <cassert>
 #include <memory>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
+#include "pool.hh"
 #include "value.hh"
 #include "selector.hh"
 
 enum var_id: unsigned {};
 
+// A counted reference to a value.  Stacks hold values through these,
+// so that a copy of a stack can share the values with the original
+// instead of cloning them.
+//
+// Values on a stack are treated as immutable.  Code that wants to
+// modify a value pops it first, and popping a value that is shared
+// yields a copy.  Stacks are never shared between threads, so the
+// reference count doesn't need to be atomic.
+class value_ref
+{
+  value *m_value;
+
+public:
+  explicit value_ref (std::unique_ptr <value> vp)
+    : m_value {vp.release ()}
+  {
+    assert (m_value != nullptr && m_value->m_refs == 0);
+    m_value->m_refs = 1;
+  }
+
+  value_ref (value_ref const &that)
+    : m_value {that.m_value}
+  {
+    if (m_value != nullptr)
+      ++m_value->m_refs;
+  }
+
+  value_ref (value_ref &&that) noexcept
+    : m_value {that.m_value}
+  {
+    that.m_value = nullptr;
+  }
+
+  ~value_ref ()
+  {
+    if (m_value != nullptr && --m_value->m_refs == 0)
+      delete m_value;
+  }
+
+  value_ref &
+  operator= (value_ref that) noexcept
+  {
+    std::swap (m_value, that.m_value);
+    return *this;
+  }
+
+  value *get () const { return m_value; }
+  value &operator* () const { return *m_value; }
+  value *operator-> () const { return m_value; }
+
+  // Give up the reference.  Return the value if this was the only
+  // reference to it, otherwise return a copy.
+  std::unique_ptr <value>
+  take ()
+  {
+    value *v = m_value;
+    m_value = nullptr;
+    if (--v->m_refs == 0)
+      return std::unique_ptr <value> (v);
+    return v->clone ();
+  }
+};
+
 // Stack is a container type that's used for maintaining stacks of dwgrep
-// values.
+// values.  A stack is allocated for each value that a query yields,
+// so stacks and their (typically short) value vectors are pooled.
 class stack
+  : public pooled <stack>
 {
-  std::vector <std::unique_ptr <value>> m_values;
+public:
+  typedef std::vector <value_ref, pool_allocator <value_ref>> values_t;
+
+private:
+  values_t m_values;
   selector::sel_t m_profile;
 
 public:
@@ -53,7 +125,8 @@ public:
     : m_profile {0}
   {}
 
-  stack (stack const &other);
+  // The copy shares values with OTHER.
+  stack (stack const &other) = default;
   stack (stack &&other) = default;
 
   size_t
@@ -73,7 +146,18 @@ public:
   {
     m_profile <<= 8;
     m_profile |= vp->get_type ().code ();
-    m_values.push_back (std::move (vp));
+    m_values.emplace_back (std::move (vp));
+  }
+
+  // Push another reference to the value at DEPTH.
+  void
+  push_shared (unsigned depth)
+  {
+    need (depth + 1);
+    value_ref ref = *(m_values.rbegin () + depth);
+    m_profile <<= 8;
+    m_profile |= ref->get_type ().code ();
+    m_values.push_back (std::move (ref));
   }
 
   void
@@ -87,7 +171,7 @@ public:
   pop ()
   {
     need (1);
-    auto ret = std::move (m_values.back ());
+    auto ret = m_values.back ().take ();
     m_values.pop_back ();
     m_profile >>= 8;
     if (m_values.size () >= selector::W)
@@ -159,6 +243,9 @@ public:
 
   bool operator< (stack const &that) const;
   bool operator== (stack const &that) const;
+
+  // Stacks that are operator== have the same hash.
+  size_t hash () const;
 };
 
 #endif /* _STK_H_ */
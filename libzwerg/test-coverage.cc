@@ -35,3 +35,64 @@ TEST (CoverageTest, format_empty_coverage)
   std::string str = cov::format_ranges (cov);
   ASSERT_EQ ("[)", str);
 }
+
+namespace
+{
+  coverage
+  make_coverage (std::vector <cov_range> const &ranges)
+  {
+    coverage cov;
+    for (auto const &r: ranges)
+      cov.add (r.start, r.length);
+    return cov;
+  }
+}
+
+TEST (CoverageTest, builder_matches_add)
+{
+  std::vector <cov_range> ranges
+    = {{50, 10}, {0, 5}, {5, 5}, {30, 2}, {55, 20}, {31, 0}, {100, 1}};
+
+  coverage::builder bld;
+  for (auto const &r: ranges)
+    bld.add (r.start, r.length);
+
+  ASSERT_EQ (make_coverage (ranges), bld.build ());
+}
+
+TEST (CoverageTest, add_all)
+{
+  coverage a = make_coverage ({{0, 10}, {20, 10}, {40, 10}});
+  coverage b = make_coverage ({{5, 10}, {30, 5}, {60, 1}});
+
+  coverage c = a;
+  c.add_all (b);
+  ASSERT_EQ (make_coverage ({{0, 15}, {20, 15}, {40, 10}, {60, 1}}), c);
+  ASSERT_EQ (make_coverage ({{0, 10}, {20, 10}, {40, 10}}), a);
+}
+
+TEST (CoverageTest, remove_all)
+{
+  coverage a = make_coverage ({{0, 10}, {20, 10}, {40, 10}});
+
+  coverage c = a;
+  ASSERT_TRUE (c.remove_all (make_coverage ({{5, 20}, {42, 2}})));
+  ASSERT_EQ (make_coverage ({{0, 5}, {25, 5}, {40, 2}, {44, 6}}), c);
+  ASSERT_EQ (make_coverage ({{0, 10}, {20, 10}, {40, 10}}), a);
+
+  ASSERT_FALSE (c.remove_all (make_coverage ({{10, 10}, {60, 5}})));
+  ASSERT_EQ (make_coverage ({{0, 5}, {25, 5}, {40, 2}, {44, 6}}), c);
+}
+
+TEST (CoverageTest, intersect)
+{
+  coverage a = make_coverage ({{0, 10}, {20, 10}, {40, 10}});
+  coverage b = make_coverage ({{5, 20}, {29, 12}, {45, 1}, {49, 10}});
+
+  ASSERT_EQ (make_coverage ({{5, 5}, {20, 5}, {29, 1}, {40, 1},
+			     {45, 1}, {49, 1}}),
+	     a.intersect (b));
+  ASSERT_EQ (a.intersect (b), b.intersect (a));
+  ASSERT_TRUE (a.intersect (coverage {}).empty ());
+  ASSERT_EQ (make_coverage ({{2, 3}}), a.intersect (2, 3));
+}
@@ -28,6 +28,7 @@
    not, see <http://www.gnu.org/licenses/>.  */
 
 #include <gtest/gtest.h>
+#include <sstream>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -313,6 +314,58 @@ TEST_F (ZwTest, raw_and_cooked_values_compare_equal)
 	      "== [A raw unit entry attribute])").size ());
 }
 
+TEST_F (ZwTest, closure_dedup_of_imported_dies)
+{
+  // The DIE at 0x14 of dwz-partial is imported into four units.  The
+  // four DIE's differ only in import path, and closures must keep
+  // them apart, so that each of them is yielded for each start.
+  ASSERT_EQ (16, run_dwquery
+	     (*builtins, "dwz-partial",
+	      "[entry (offset == 0x14)] (|L| L elem (drop L elem)*)"
+	      ).size ());
+
+  // A raw DIE has no import path, and compares equal to all of them.
+  ASSERT_EQ (4, run_dwquery
+	     (*builtins, "dwz-partial",
+	      "[entry (offset == 0x14)] (|L| L elem raw (drop L elem)*)"
+	      ).size ());
+  ASSERT_EQ (4, run_dwquery
+	     (*builtins, "dwz-partial",
+	      "[entry (offset == 0x14)] (|L| L elem (drop L elem raw)*)"
+	      ).size ());
+}
+
+TEST_F (ZwTest, pegged_and_runtime_dispatch_agree)
+{
+  // Queries built for a stack with a Dwarf pick overloads of the
+  // words that follow it statically.  They must yield what queries
+  // that dispatch at run time do.
+  for (auto q: {"entry name", "raw unit root name", "entry ?TAG_subprogram",
+		"abbrev entry code", "[entry] length", "symbol name",
+		"entry (|D| D, D attribute) pos"})
+    {
+      auto show = [&] (std::vector <std::unique_ptr <stack>> yielded)
+	{
+	  std::vector <std::string> ret;
+	  for (auto const &stk: yielded)
+	    {
+	      std::ostringstream ss;
+	      stk->top ().show (ss);
+	      ret.push_back (ss.str ());
+	    }
+	  return ret;
+	};
+
+      auto runtime = show (run_query (*builtins,
+				      stack_with_value (rdw ("twocus")), q));
+      auto pegged = show (run_query_pegged (*builtins,
+					    stack_with_value (rdw ("twocus")),
+					    q));
+      ASSERT_FALSE (runtime.empty ());
+      ASSERT_EQ (runtime, pegged);
+    }
+}
+
 TEST_F (ZwTest, entry_unit_abbrev_iterate_through_alt_file)
 {
   // Show root entries in a1.out, which should show a compile unit
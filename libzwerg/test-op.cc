@@ -28,10 +28,12 @@
    not, see <http://www.gnu.org/licenses/>.  */
 
 #include <gtest/gtest.h>
+#include <sstream>
 
 #include "op.hh"
 #include "init.hh"
 #include "value-cst.hh"
+#include "value-str.hh"
 #include "test-zw-aux.hh"
 
 struct ZwTest
@@ -153,6 +155,12 @@ namespace
       else
 	return cmp_result::fail;
     }
+
+    size_t
+    hash () const override
+    {
+      return 0;
+    }
   };
 
   value_type const value_canary::vtype = value_type::alloc ("canary", "");
@@ -185,6 +193,119 @@ TEST_F (ZwTest, frame_with_value_referencing_it_doesnt_leak_3)
   ASSERT_EQ (1, counter.use_count ());
 }
 
+namespace
+{
+  // For a stack of one value, yield M_N copies of it with a canary on
+  // top.  Stacks with more values have no children.
+  struct op_fan
+    : public inner_op
+  {
+    struct state
+    {
+      std::unique_ptr <stack> m_stk;
+      size_t m_i;
+    };
+
+    layout::loc m_ll;
+    size_t m_n;
+    std::shared_ptr <empty> m_counter;
+
+    op_fan (layout &l, std::shared_ptr <op> upstream, size_t n,
+	    std::shared_ptr <empty> counter)
+      : inner_op {upstream}
+      , m_ll {l.reserve <state> ()}
+      , m_n {n}
+      , m_counter {counter}
+    {}
+
+    void
+    state_con (scon &sc) const override
+    {
+      sc.con <state> (m_ll);
+      inner_op::state_con (sc);
+    }
+
+    void
+    state_des (scon &sc) const override
+    {
+      inner_op::state_des (sc);
+      sc.des <state> (m_ll);
+    }
+
+    stack::uptr
+    next (scon &sc) const override
+    {
+      state &st = sc.get <state> (m_ll);
+      while (true)
+	{
+	  if (st.m_stk == nullptr)
+	    {
+	      st.m_stk = m_upstream->next (sc);
+	      st.m_i = 0;
+	      if (st.m_stk == nullptr)
+		return nullptr;
+	    }
+
+	  if (st.m_stk->size () == 1 && st.m_i < m_n)
+	    {
+	      ++st.m_i;
+	      auto ret = std::make_unique <stack> (*st.m_stk);
+	      ret->push (std::make_unique <value_canary> (m_counter));
+	      return ret;
+	    }
+
+	  st.m_stk = nullptr;
+	}
+    }
+
+    bool
+    acyclic (stack &stk) const override
+    {
+      return true;
+    }
+
+    std::string
+    name () const override
+    {
+      return "fan";
+    }
+  };
+}
+
+TEST_F (ZwTest, closure_of_wide_root_holds_only_current_path)
+{
+  // Each yielded stack is dropped right away, so canaries that are
+  // alive are those that the closure holds on to.
+  auto counter = std::make_shared <empty> ();
+  layout l, op_l;
+  auto inner_origin = std::make_shared <op_origin> (op_l);
+  auto inner = std::make_shared <op_fan> (op_l, inner_origin, 1000, counter);
+  auto outer_origin = std::make_shared <op_origin> (l);
+  auto outer = std::make_shared <op_tr_closure> (l, outer_origin, op_l,
+						 inner_origin, inner,
+						 op_tr_closure_kind::star);
+
+  scon sc {l};
+  scon_guard sg {sc, *outer};
+  outer_origin->set_next
+    (sc, stack_with_value (std::make_unique <value_cst>
+			   (constant {0, &dec_constant_dom}, 0)));
+
+  // The test and op_fan hold a reference each.
+  long const base = counter.use_count ();
+  size_t n = 0;
+  long max_alive = 0;
+  while (auto stk = outer->next (sc))
+    {
+      ++n;
+      max_alive = std::max (max_alive, counter.use_count () - base);
+    }
+
+  ASSERT_EQ (1001, n);
+  ASSERT_GE (2, max_alive);
+  ASSERT_EQ (base, counter.use_count ());
+}
+
 TEST_F (ZwTest, iterate_lexical_closure_1)
 {
   auto stk = std::make_unique <stack> ();
@@ -199,6 +320,79 @@ TEST_F (ZwTest, iterate_lexical_closure_2)
   ASSERT_EQ (2, yielded.size ());
 }
 
+TEST_F (ZwTest, stack_copies_share_values)
+{
+  stack stk;
+  stk.push (std::make_unique <value_str> ("a", 1));
+  stack copy {stk};
+  ASSERT_EQ (&stk.top (), &copy.top ());
+
+  // Popping a value that's shared yields a copy, which can be
+  // modified without the other stack noticing.
+  auto v = copy.pop_as <value_str> ();
+  ASSERT_NE (&stk.top (), v.get ());
+  v->set_pos (2);
+  v->get_string () += "b";
+  ASSERT_EQ (1, stk.top ().get_pos ());
+  ASSERT_EQ ("a", stk.top_as <value_str> ()->get_string ());
+
+  // Once nobody else has it, the value itself is popped.
+  value *orig = &stk.top ();
+  ASSERT_EQ (orig, stk.pop ().get ());
+}
+
+TEST_F (ZwTest, stack_dup_over_share_values)
+{
+  stack stk;
+  stk.push (std::make_unique <value_str> ("a", 0));
+  stk.push (std::make_unique <value_str> ("b", 0));
+  stk.push_shared (1);
+  stk.push_shared (0);
+  ASSERT_EQ (&stk.get (0), &stk.get (1));
+  ASSERT_EQ (&stk.get (1), &stk.get (3));
+
+  auto v = stk.pop_as <value_str> ();
+  v->get_string () += "c";
+  ASSERT_EQ ("a", stk.top_as <value_str> ()->get_string ());
+  ASSERT_EQ ("a", stk.get_as <value_str> (2)->get_string ());
+}
+
+TEST_F (ZwTest, modifying_dup_over_copies)
+{
+  for (auto const &entry: std::vector <std::pair <size_t, std::string>> {
+	    {1, "\"a\" dup \"b\" add [|A B| A, B] == [\"a\", \"ab\"]"},
+	    {1, "\"a\" dup \"b\" swap add [|A B| A, B] == [\"a\", \"ba\"]"},
+	    {1, "\"a\" \"b\" over \"c\" add [|A B C| A, B, C] "
+		"== [\"a\", \"b\", \"ac\"]"},
+	    {1, "[1] dup [2] add [|A B| A, B] == [[1], [1, 2]]"},
+	    {1, "[1] [2] over dup [3] add [|A B C D| A, B, C, D] "
+		"== [[1], [2], [1], [1, 3]]"},
+	    {1, "\"a\" dup \"%s-\" [|A B| A, B] == [\"a\", \"a-\"]"},
+	    {1, "[5, 6] dup elem (pos == 1) [|A B| A, B] == [[5, 6], 6]"},
+	})
+    {
+      auto stk = std::make_unique <stack> ();
+      auto yielded = run_query (*builtins, std::move (stk), entry.second);
+      ASSERT_EQ (entry.first, yielded.size ()) << entry.second;
+    }
+}
+
+TEST_F (ZwTest, closure_dedup_of_constants)
+{
+  // Constants in arithmetic domains compare, and thus deduplicate, by
+  // value alone.  Named constants are kept apart from plain ones.
+  for (auto const &entry: std::vector <std::pair <size_t, std::string>> {
+	    {2, "0 (drop (1, 0x1, 0b1))*"},
+	    {2, "0 (drop (0x1, 1))*"},
+	    {3, "0 (drop (1, true))*"},
+	})
+    {
+      auto stk = std::make_unique <stack> ();
+      auto yielded = run_query (*builtins, std::move (stk), entry.second);
+      ASSERT_EQ (entry.first, yielded.size ());
+    }
+}
+
 TEST_F (ZwTest, test_1)
 {
   // This caused SIGSEGV due to wrong upvalue tracking.
@@ -280,6 +474,74 @@ TEST_F (ZwTest, test_assert_subx)
     }
 }
 
+TEST_F (ZwTest, test_pegged_overloads)
+{
+  for (auto const &entry: std::vector <std::pair <size_t, std::string>> {
+	    {1, "1 2 add == 3"},
+	    {1, "\"a\" \"b\" add == \"ab\""},
+	    {1, "[1] [2, 3] add length == 3"},
+	    {1, "1 dup add 5 swap sub == 3"},
+	    {1, "1 2 3 rot [|A B C| A, B, C] == [2, 3, 1]"},
+	    {1, "1 \"ab\" over drop drop 1 add == 2"},
+	    {2, "(\"ab\", [1, 2]) length 2 ?eq"},
+	    {1, "(\"ab\", [1]) length == 2"},
+	    {1, "(if ?(1 1 ?eq) then \"a\" else \"bc\") length == 1"},
+	})
+    {
+      auto stk = std::make_unique <stack> ();
+      auto yielded = run_query (*builtins, std::move (stk), entry.second);
+      ASSERT_EQ (entry.first, yielded.size ());
+    }
+
+  for (auto run: {run_query, run_query_pegged})
+    {
+      auto yielded = run (*builtins,
+			  stack_with_value (std::make_unique <value_str>
+					    ("abc", 0)),
+			  "length == 3");
+      ASSERT_EQ (1, yielded.size ());
+    }
+}
+
+TEST_F (ZwTest, test_pegged_overloads_merge)
+{
+  // Each prefix yields stacks whose TOS differs in type.  The word
+  // after it must yield the same as when TOS is hidden behind a
+  // variable, and the overload is therefore looked up at run time.
+  for (auto const &entry: std::vector <std::tuple <size_t, std::string,
+						   std::string>> {
+	    {2, "[1] (drop \"ab\")*", "length"},
+	    {1, "[1] (drop \"ab\")+", "length"},
+	    {3, "[1] (drop \"ab\", drop [1, 2])*", "length"},
+	    {2, "1 (drop \"a\")* dup", "add"},
+	    {2, "\"ab\" ([1] swap drop)?", "length"},
+	    {2, "(\"ab\", [1])", "length"},
+	    {2, "(1, 2) (if (dup 1 ?eq) then (drop \"abc\")"
+		" else (drop [1]))", "length"},
+	    {2, "(1, 2) (?(1 ?eq) drop \"abc\" || drop [1])", "length"},
+	})
+    {
+      auto tos = [&] (std::string q)
+	{
+	  std::vector <std::string> ret;
+	  for (auto const &stk: run_query (*builtins,
+					   std::make_unique <stack> (), q))
+	    {
+	      std::ostringstream ss;
+	      stk->top ().show (ss);
+	      ret.push_back (ss.str ());
+	    }
+	  return ret;
+	};
+
+      auto pegged = tos (std::get <1> (entry) + " " + std::get <2> (entry));
+      auto unpegged = tos (std::get <1> (entry)
+			   + " (|A| A " + std::get <2> (entry) + ")");
+      ASSERT_EQ (std::get <0> (entry), unpegged.size ());
+      ASSERT_EQ (unpegged, pegged);
+    }
+}
+
 TEST_F (ZwTest, test_assert_block)
 {
   for (auto const &entry: std::map <size_t, std::string> {
@@ -0,0 +1,156 @@
+/*
+   Copyright (C) 2026 Petr Machata
+   This file is part of dwgrep.
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   dwgrep is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.  */
+
+#include <gtest/gtest.h>
+#include "overload.hh"
+#include "value-cst.hh"
+#include "value-seq.hh"
+#include "value-str.hh"
+
+namespace
+{
+  std::unique_ptr <value>
+  cst ()
+  {
+    return std::make_unique <value_cst> (constant {1, &dec_constant_dom}, 0);
+  }
+
+  std::unique_ptr <value>
+  str ()
+  {
+    return std::make_unique <value_str> ("x", 0);
+  }
+
+  std::unique_ptr <value>
+  seq ()
+  {
+    return std::make_unique <value_seq> (value_seq::seq_t {}, 0);
+  }
+
+  // A stack with values made by MAKERS, the last of them at TOS.
+  stack
+  stack_of (std::initializer_list <std::unique_ptr <value> (*) ()> makers)
+  {
+    stack stk;
+    for (auto make: makers)
+      stk.push (make ());
+    return stk;
+  }
+
+  struct named_builtin
+    : public builtin
+  {
+    char const *m_name;
+
+    explicit named_builtin (char const *name)
+      : m_name {name}
+    {}
+
+    char const *
+    name () const override
+    {
+      return m_name;
+    }
+  };
+
+  char const *
+  overload_name (overload_tab const &tab, stack_profile const &profile)
+  {
+    auto bi = tab.find_overload (profile);
+    return bi != nullptr ? bi->name () : nullptr;
+  }
+}
+
+TEST (TestOverload, dispatch_by_tos)
+{
+  overload_dispatch dispatch {{{value_str::vtype},
+			       {value_cst::vtype},
+			       {value_seq::vtype}}};
+
+  ASSERT_EQ (0, dispatch.find (stack_of ({str})));
+  ASSERT_EQ (1, dispatch.find (stack_of ({str, cst})));
+  ASSERT_EQ (2, dispatch.find (stack_of ({seq})));
+  ASSERT_EQ (-1, dispatch.find (stack_of ({})));
+}
+
+TEST (TestOverload, dispatch_several_candidates_for_tos)
+{
+  // All of these expect T_CONST at TOS, and the first that matches
+  // deeper in the stack is picked.
+  overload_dispatch dispatch {{{value_str::vtype, value_cst::vtype},
+			       {value_seq::vtype, value_cst::vtype},
+			       {value_cst::vtype},
+			       {value_str::vtype}}};
+
+  ASSERT_EQ (0, dispatch.find (stack_of ({str, cst})));
+  ASSERT_EQ (1, dispatch.find (stack_of ({seq, cst})));
+  ASSERT_EQ (2, dispatch.find (stack_of ({cst, cst})));
+  ASSERT_EQ (2, dispatch.find (stack_of ({cst})));
+  ASSERT_EQ (3, dispatch.find (stack_of ({cst, str})));
+  ASSERT_EQ (-1, dispatch.find (stack_of ({cst, seq})));
+}
+
+TEST (TestOverload, dispatch_not_looking_at_tos)
+{
+  // A selector that doesn't look at TOS is a candidate for any TOS,
+  // but it doesn't take precedence over selectors that come before.
+  overload_dispatch dispatch {{{value_str::vtype},
+			       {value_cst::vtype, value_type {0}},
+			       {},
+			       {value_seq::vtype}}};
+
+  ASSERT_EQ (0, dispatch.find (stack_of ({cst, str})));
+  ASSERT_EQ (1, dispatch.find (stack_of ({cst, seq})));
+  ASSERT_EQ (1, dispatch.find (stack_of ({cst, cst})));
+  ASSERT_EQ (2, dispatch.find (stack_of ({seq})));
+  ASSERT_EQ (2, dispatch.find (stack_of ({})));
+}
+
+TEST (TestOverload, find_overload_with_wildcard)
+{
+  // The second overload doesn't look at TOS, it expects T_CONST
+  // below it.
+  overload_tab tab;
+  tab.add_overload ({value_str::vtype}, std::make_shared <named_builtin> ("a"));
+  tab.add_overload ({value_cst::vtype, value_type {0}},
+		    std::make_shared <named_builtin> ("b"));
+  tab.add_overload ({value_seq::vtype}, std::make_shared <named_builtin> ("c"));
+
+  auto const cst = value_cst::vtype;
+  auto const str = value_str::vtype;
+  auto const seq = value_seq::vtype;
+
+  ASSERT_STREQ ("a", overload_name (tab, {cst, str}));
+  ASSERT_STREQ ("b", overload_name (tab, {cst, seq}));
+  ASSERT_STREQ ("b", overload_name (tab, {seq, cst, cst}));
+  ASSERT_STREQ ("c", overload_name (tab, {cst, seq, seq}));
+
+  // Not known what is below TOS, and the second overload might match.
+  ASSERT_EQ (nullptr, overload_name (tab, {seq}));
+  ASSERT_EQ (nullptr, overload_name (tab, {cst}));
+}
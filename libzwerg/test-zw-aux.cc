@@ -41,23 +41,41 @@ stack_with_value (std::unique_ptr <value> v)
   return stk;
 }
 
+namespace
+{
+  std::vector <std::unique_ptr <stack>>
+  run_query_for (vocabulary &voc, std::unique_ptr <stack> stk,
+		 std::string q, stack_profile const &profile)
+  {
+    layout l;
+    auto origin = std::make_shared <op_origin> (l);
+    auto op = parse_query (q).build_exec (l, origin, voc, profile);
+
+    scon sc {l};
+    scon_guard sg {sc, *op};
+    origin->set_next (sc, std::move (stk));
+
+    std::vector <std::unique_ptr <stack>> yielded;
+    while (auto r = op->next (sc))
+      yielded.push_back (std::move (r));
+
+    return yielded;
+  }
+}
+
 std::vector <std::unique_ptr <stack>>
 run_query (vocabulary &voc,
 	   std::unique_ptr <stack> stk, std::string q)
 {
-  layout l;
-  auto origin = std::make_shared <op_origin> (l);
-  auto op = parse_query (q).build_exec (l, origin, voc);
-
-  scon sc {l};
-  scon_guard sg {sc, *op};
-  origin->set_next (sc, std::move (stk));
-
-  std::vector <std::unique_ptr <stack>> yielded;
-  while (auto r = op->next (sc))
-    yielded.push_back (std::move (r));
+  return run_query_for (voc, std::move (stk), q, {});
+}
 
-  return yielded;
+std::vector <std::unique_ptr <stack>>
+run_query_pegged (vocabulary &voc,
+		  std::unique_ptr <stack> stk, std::string q)
+{
+  auto profile = selector {*stk}.get_types ();
+  return run_query_for (voc, std::move (stk), q, profile);
 }
 
 std::string
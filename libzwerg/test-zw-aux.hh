@@ -41,6 +41,12 @@ std::unique_ptr <stack> stack_with_value (std::unique_ptr <value> v);
 std::vector <std::unique_ptr <stack>>
 run_query (vocabulary &voc, std::unique_ptr <stack> stk, std::string q);
 
+// Like run_query, but the query is built for the types on STK, like
+// zw_query_execute does, so overloads may be picked statically.
+std::vector <std::unique_ptr <stack>>
+run_query_pegged (vocabulary &voc, std::unique_ptr <stack> stk,
+		  std::string q);
+
 std::string get_parse_error (vocabulary &voc, std::string q);
 
 #endif /* TEST_ZW_AUX_H */
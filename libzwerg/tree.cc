@@ -30,6 +30,7 @@
 #include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cstring>
 #include <iostream>
 #include <set>
 #include <stdexcept>
@@ -225,6 +226,18 @@ tree::operator< (tree const &that) const
   abort ();
 }
 
+bool
+tree::uses_pos () const
+{
+  if ((m_tt == tree_type::READ && str () == "pos")
+      || (m_tt == tree_type::F_BUILTIN
+	  && std::strcmp (m_builtin->name (), "pred_pos") == 0))
+    return true;
+
+  return std::any_of (m_children.begin (), m_children.end (),
+		      [] (tree const &child) { return child.uses_pos (); });
+}
+
 void
 tree::simplify ()
 {
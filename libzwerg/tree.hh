@@ -135,6 +135,7 @@ TREE_TYPES
 class op;
 class pred;
 class scope;
+class profile;
 
 // This is for communication between lexical and syntactic analyzers
 // and the rest of the world.  It uses naked pointers all over the
@@ -171,6 +172,10 @@ public:
 
   bool operator< (tree const &that) const;
 
+  // Whether the expression can observe positions of values, i.e.
+  // whether it mentions `pos' or a ?N assertion.
+  bool uses_pos () const;
+
   // === Build interface ===
   //
   // The following methods are implemented in build.cc.  They are for
@@ -188,9 +193,18 @@ public:
   // would only create a series of nested op's).  UPSTREAM should be
   // an op_origin if this is the toplevel-most expression, otherwise it
   // should be a valid op that the op produced by this node feeds off.
+  //
+  // INPUT is what is known about types of values near TOS of stacks
+  // that the op will be given.  Overloaded words whose overload that
+  // determines are built without dispatching at runtime.  The op
+  // shall then only be given such stacks.
+  //
+  // If PROF is not nullptr, parts of the expression are instrumented
+  // to record execution statistics into PROF.  See class profile.
   std::shared_ptr <op>
   build_exec (layout &l, std::shared_ptr <op> upstream,
-	      vocabulary const &voc) const;
+	      vocabulary const &voc, stack_profile const &input = {},
+	      std::shared_ptr <profile> prof = nullptr) const;
 
   // === Parser interface ===
   //
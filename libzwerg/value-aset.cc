@@ -83,3 +83,13 @@ value_aset::cmp (value const &that) const
   else
     return cmp_result::fail;
 }
+
+size_t
+value_aset::hash () const
+{
+  size_t ret = cov.size ();
+  for (size_t i = 0; i < cov.size (); ++i)
+    ret = hash_combine (hash_combine (ret, cov.at (i).start),
+			cov.at (i).length);
+  return ret;
+}
@@ -57,6 +57,7 @@ struct value_aset
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 #endif /* VALUE_ASET_H */
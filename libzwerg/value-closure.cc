@@ -78,3 +78,13 @@ value_closure::cmp (value const &v) const
   else
     return cmp_result::fail;
 }
+
+size_t
+value_closure::hash () const
+{
+  // Environments are compared by identity.
+  size_t ret = std::hash <op const *> {} (m_op.get ());
+  for (auto const &envv: m_env)
+    ret = hash_combine (ret, std::hash <value const *> {} (envv.get ()));
+  return ret;
+}
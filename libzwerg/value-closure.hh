@@ -55,6 +55,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 
   layout const &get_layout () const
   { return m_op_layout; }
@@ -79,6 +79,14 @@ value_cst::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_cst::hash () const
+{
+  // Constants of different domains may compare equal, so only hash
+  // the value.
+  return std::hash <uint64_t> {} (m_cst.value ().m_u);
+}
+
 
 // value
 
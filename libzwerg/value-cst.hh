@@ -30,12 +30,14 @@
 #ifndef _VALUE_CST_H_
 #define _VALUE_CST_H_
 
+#include "pool.hh"
 #include "value.hh"
 #include "op.hh"
 #include "overload.hh"
 
 class value_cst
   : public value
+  , public pooled <value_cst>
 {
   constant m_cst;
 
@@ -55,6 +57,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 struct op_value_cst
@@ -185,6 +185,12 @@ value_dwarf::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_dwarf::hash () const
+{
+  return std::hash <Dwfl *> {} (m_dwctx->get_dwfl ());
+}
+
 
 value_type const value_cu::vtype = value_type::alloc ("T_CU",
 R"docstring(
@@ -221,6 +227,12 @@ value_cu::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_cu::hash () const
+{
+  return std::hash <Dwarf_CU const *> {} (&m_cu);
+}
+
 
 namespace
 {
@@ -298,6 +310,15 @@ value_die::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_die::hash () const
+{
+  // DIE's with different import paths may compare equal, so the path
+  // is not hashed.
+  return hash_combine (std::hash <Dwarf *> {} (dwarf_cu_getdwarf (m_die.cu)),
+		       dwarf_dieoffset ((Dwarf_Die *) &m_die));
+}
+
 namespace
 {
   bool
@@ -400,6 +421,14 @@ value_attr::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_attr::hash () const
+{
+  return hash_combine
+    (dwarf_dieoffset (const_cast <Dwarf_Die *> (&get_die ())),
+     dwarf_whatattr ((Dwarf_Attribute *) &m_attr));
+}
+
 
 value_type const value_abbrev_unit::vtype = value_type::alloc ("T_ABBREV_UNIT",
 R"docstring(
@@ -435,6 +464,12 @@ value_abbrev_unit::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_abbrev_unit::hash () const
+{
+  return std::hash <Dwarf_CU const *> {} (&m_cu);
+}
+
 
 value_type const value_abbrev::vtype = value_type::alloc ("T_ABBREV",
 R"docstring(
@@ -482,6 +517,12 @@ value_abbrev::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_abbrev::hash () const
+{
+  return std::hash <Dwarf_Abbrev const *> {} (&m_abbrev);
+}
+
 
 value_type const value_abbrev_attr::vtype = value_type::alloc ("T_ABBREV_ATTR",
 R"docstring(
@@ -522,6 +563,12 @@ value_abbrev_attr::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_abbrev_attr::hash () const
+{
+  return offset;
+}
+
 
 namespace
 {
@@ -630,6 +677,17 @@ value_loclist_elem::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_loclist_elem::hash () const
+{
+  size_t ret = std::hash <void *> {} (m_attr.valp);
+  ret = hash_combine (hash_combine (ret, m_low), m_high);
+  for (size_t i = 0; i < m_exprlen; ++i)
+    ret = hash_combine (hash_combine (ret, m_expr[i].atom),
+			m_expr[i].offset);
+  return ret;
+}
+
 
 value_type const value_loclist_op::vtype = value_type::alloc ("T_LOCLIST_OP",
 R"docstring(
@@ -673,3 +731,9 @@ value_loclist_op::cmp (value const &that) const
   else
     return cmp_result::fail;
 }
+
+size_t
+value_loclist_op::hash () const
+{
+  return hash_combine (std::hash <void *> {} (m_attr.valp), m_dwop->offset);
+}
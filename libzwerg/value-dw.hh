@@ -30,6 +30,7 @@
 #define _VALUE_DW_H_
 
 #include <elfutils/libdwfl.h>
+#include "pool.hh"
 #include "value.hh"
 #include "dwfl_context.hh"
 
@@ -86,6 +87,7 @@ public:
 
   void show (std::ostream &o) const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
   std::unique_ptr <value> clone () const override;
 };
 
@@ -126,6 +128,7 @@ public:
 
   void show (std::ostream &o) const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
   std::unique_ptr <value> clone () const override;
 };
 
@@ -163,6 +166,7 @@ public:
 class value_die
   : public value
   , public doneness_aspect
+  , public pooled <value_die>
 {
   std::shared_ptr <dwfl_context> m_dwctx;
   Dwarf_Die m_die;
@@ -213,6 +217,7 @@ public:
   { return std::make_unique <value_die> (*this); }
 
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 
   std::unique_ptr <value_die> get_parent () const;
 
@@ -230,6 +235,7 @@ public:
 class value_attr
   : public value
   , public doneness_aspect
+  , public pooled <value_attr>
 {
   value_die m_die;
   Dwarf_Attribute m_attr;
@@ -272,6 +278,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 
   value_dwarf &
   get_dwarf ()
@@ -311,6 +318,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 // -------------------------------------------------------------------
@@ -344,6 +352,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 // -------------------------------------------------------------------
@@ -372,6 +381,7 @@ struct value_abbrev_attr
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 // -------------------------------------------------------------------
@@ -429,6 +439,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 // -------------------------------------------------------------------
@@ -474,6 +485,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 #endif /* _VALUE_DW_H_ */
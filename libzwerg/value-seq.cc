@@ -142,6 +142,16 @@ value_seq::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_seq::hash () const
+{
+  size_t ret = m_seq->size ();
+  for (auto const &v: *m_seq)
+    ret = hash_combine (ret, hash_combine (v->get_type ().code (),
+					   v->hash ()));
+  return ret;
+}
+
 value_seq
 op_add_seq::operate (std::unique_ptr <value_seq> a,
 		     std::unique_ptr <value_seq> b) const
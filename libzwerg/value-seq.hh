@@ -68,6 +68,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 struct op_add_seq
@@ -27,9 +27,12 @@
    the GNU Lesser General Public License along with this program.  If
    not, see <http://www.gnu.org/licenses/>.  */
 
+#include <cstring>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <regex.h>
+#include <unordered_map>
 
 #include "value-str.hh"
 #include "overload.hh"
@@ -69,6 +72,12 @@ value_str::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_str::hash () const
+{
+  return std::hash <std::string> {} (m_str);
+}
+
 
 value_str
 op_add_str::operate (std::unique_ptr <value_str> a,
@@ -306,37 +315,160 @@ pred_ends_str::docstring ()
 
 // ?match
 
-pred_result
-pred_match_str::result (value_str &haystack, value_str &needle) const
+namespace
 {
-  regex_t re;
-  if (regcomp (&re, needle.get_string ().c_str(),
-	       REG_EXTENDED | REG_NOSUB) != 0)
+  // A pattern for ?match.  Patterns that are just a string, possibly
+  // anchored with ^ or $, or surrounded by .*'s, are matched by
+  // comparing strings.  Other patterns are compiled with regcomp.
+  class match_pattern
+  {
+    std::string m_pattern;
+
+    // Whether M_LITERAL is used instead of M_RE.
+    bool m_simple;
+    std::string m_literal;
+    bool m_anchor_start;
+    bool m_anchor_end;
+
+    bool m_compiled;
+    regex_t m_re;
+
+    bool
+    parse_simple ()
     {
-      std::cerr << "Error: could not compile regular expression: '"
-		<< needle.get_string () << "'\n";
-      return pred_result::fail;
+      std::string const &pat = m_pattern;
+      size_t b = 0;
+      size_t e = pat.size ();
+
+      m_anchor_start = b < e && pat[b] == '^';
+      if (m_anchor_start)
+	++b;
+      for (; e - b >= 2 && pat.compare (b, 2, ".*") == 0; b += 2)
+	m_anchor_start = false;
+
+      m_anchor_end = e > b && pat[e - 1] == '$';
+      if (m_anchor_end)
+	--e;
+      for (; e - b >= 2 && pat.compare (e - 2, 2, ".*") == 0; e -= 2)
+	m_anchor_end = false;
+
+      // Leave empty patterns to regcomp.  Note that strchr finds the
+      // terminating NUL, which rejects patterns with NUL's as well.
+      if (b == e)
+	return false;
+      for (size_t i = b; i < e; ++i)
+	if (std::strchr (".[]()*+?{}|^$\\", pat[i]) != nullptr)
+	  return false;
+
+      m_literal = pat.substr (b, e - b);
+      return true;
     }
 
-  const int reti = regexec (&re, haystack.get_string ().c_str (),
-			    /* nmatch: size of pmatch array */ 0,
-			    /* pmatch: array of matches */ NULL,
-			    /* no extra flags */ 0);
+    bool
+    match_simple (char const *hay) const
+    {
+      size_t len = std::strlen (hay);
+      size_t n = m_literal.size ();
+      char const *lit = m_literal.c_str ();
+
+      if (m_anchor_start && m_anchor_end)
+	return len == n && std::memcmp (hay, lit, n) == 0;
+      if (m_anchor_start)
+	return len >= n && std::memcmp (hay, lit, n) == 0;
+      if (m_anchor_end)
+	return len >= n && std::memcmp (hay + len - n, lit, n) == 0;
+      return std::strstr (hay, lit) != nullptr;
+    }
 
-  pred_result retval = pred_result::fail;
-  if (reti == 0)
-    retval = pred_result::yes;
-  else if (reti == REG_NOMATCH)
-    retval = pred_result::no;
-  else
+  public:
+    explicit match_pattern (std::string pattern)
+      : m_pattern {std::move (pattern)}
+    {
+      m_simple = parse_simple ();
+      m_compiled = m_simple || regcomp (&m_re, m_pattern.c_str (),
+					REG_EXTENDED | REG_NOSUB) == 0;
+    }
+
+    ~match_pattern ()
     {
+      if (m_compiled && ! m_simple)
+	regfree (&m_re);
+    }
+
+    match_pattern (match_pattern const &) = delete;
+    match_pattern &operator= (match_pattern const &) = delete;
+
+    pred_result
+    match (std::string const &haystack) const
+    {
+      if (! m_compiled)
+	{
+	  std::cerr << "Error: could not compile regular expression: '"
+		    << m_pattern << "'\n";
+	  return pred_result::fail;
+	}
+
+      if (m_simple)
+	return pred_result (match_simple (haystack.c_str ()));
+
+      const int reti = regexec (&m_re, haystack.c_str (),
+				/* nmatch: size of pmatch array */ 0,
+				/* pmatch: array of matches */ NULL,
+				/* no extra flags */ 0);
+
+      if (reti == 0)
+	return pred_result::yes;
+      else if (reti == REG_NOMATCH)
+	return pred_result::no;
+
       char msgbuf[100];
-      regerror (reti, &re, msgbuf, sizeof (msgbuf));
+      regerror (reti, &m_re, msgbuf, sizeof (msgbuf));
       std::cerr << "Error: match failed: " << msgbuf << "\n";
+      return pred_result::fail;
     }
+  };
 
-  regfree (&re);
-  return retval;
+  // Recently used patterns, so that the same pattern isn't compiled
+  // for every haystack.  The pred itself is shared by all threads
+  // that run a query, so each thread has its own cache.
+  class match_cache
+  {
+    static size_t const max_size = 64;
+
+    typedef std::pair <std::string, std::unique_ptr <match_pattern>> entry;
+    std::list <entry> m_lru;
+    std::unordered_map <std::string, std::list <entry>::iterator> m_index;
+
+  public:
+    match_pattern const &
+    get (std::string const &pattern)
+    {
+      auto it = m_index.find (pattern);
+      if (it != m_index.end ())
+	{
+	  m_lru.splice (m_lru.begin (), m_lru, it->second);
+	  return *it->second->second;
+	}
+
+      if (m_lru.size () == max_size)
+	{
+	  m_index.erase (m_lru.back ().first);
+	  m_lru.pop_back ();
+	}
+
+      m_lru.emplace_front (pattern,
+			   std::make_unique <match_pattern> (pattern));
+      m_index.emplace (pattern, m_lru.begin ());
+      return *m_lru.front ().second;
+    }
+  };
+}
+
+pred_result
+pred_match_str::result (value_str &haystack, value_str &needle) const
+{
+  thread_local match_cache cache;
+  return cache.get (needle.get_string ()).match (haystack.get_string ());
 }
 
 std::string
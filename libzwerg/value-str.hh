@@ -32,6 +32,7 @@
 
 #include <string>
 
+#include "pool.hh"
 #include "value.hh"
 #include "op.hh"
 #include "overload.hh"
@@ -39,6 +40,7 @@
 
 class value_str
   : public value
+  , public pooled <value_str>
 {
   std::string m_str;
 
@@ -59,6 +61,7 @@ public:
   void show (std::ostream &o) const override;
   std::unique_ptr <value> clone () const override;
   cmp_result cmp (value const &that) const override;
+  size_t hash () const override;
 };
 
 struct op_add_str
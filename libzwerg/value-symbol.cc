@@ -70,6 +70,12 @@ value_symbol::cmp (value const &that) const
     return cmp_result::fail;
 }
 
+size_t
+value_symbol::hash () const
+{
+  return m_symidx;
+}
+
 constant
 value_symbol::get_type () const
 {
@@ -29,6 +29,7 @@
 #ifndef _VALUE_H_
 #define _VALUE_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -43,6 +44,13 @@ enum class cmp_result
   };
 std::ostream &operator<< (std::ostream &o, cmp_result result);
 
+// Mix hash H into SEED.
+inline size_t
+hash_combine (size_t seed, size_t h)
+{
+  return seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 template <class T>
 cmp_result
 compare (T const &a, T const &b)
@@ -117,16 +125,28 @@ extern constant_dom const &slot_type_dom;
 
 class zw_value
 {
+  friend class value_ref;
+
   value_type const m_type;
+
+  // Number of value_ref's that refer to this value.
+  unsigned m_refs;
+
   size_t m_pos;
 
 protected:
   zw_value (value_type t, size_t pos)
     : m_type {t}
+    , m_refs {0}
     , m_pos {pos}
   {}
 
-  zw_value (zw_value const &that) = default;
+  // A copy is not referenced by anyone yet.
+  zw_value (zw_value const &that)
+    : m_type {that.m_type}
+    , m_refs {0}
+    , m_pos {that.m_pos}
+  {}
 
 public:
   static value_type const vtype;
@@ -139,6 +159,10 @@ public:
   virtual std::unique_ptr <zw_value> clone () const = 0;
   virtual cmp_result cmp (zw_value const &that) const = 0;
 
+  // Values for which cmp returns cmp_result::equal have to hash to
+  // the same number.
+  virtual size_t hash () const = 0;
+
   void
   set_pos (size_t pos)
   {
@@ -68,6 +68,42 @@ expect_out ()
     rm -f $TMP
 }
 
+# expect_same_rewritten SED FILES QUERY...
+# Expect each QUERY to yield on FILES what it yields when rewritten
+# by sed script SED.  The rewrite hides the query from an
+# optimization, so that both ways of computing the result are
+# compared.
+expect_same_rewritten ()
+{
+    SED=$1
+    FILES=$2
+    shift 2
+    for Q in "$@"; do
+	Q2=$(echo "$Q" | sed "$SED")
+	expect_out "$($DWGREP $FILES -e "$Q2")" $FILES -e "$Q"
+    done
+}
+
+# expect_same_set_rewritten SED FILES QUERY...
+# Like expect_same_rewritten, but QUERY may yield in a different
+# order.  Each of FILES is run separately.
+expect_same_set_rewritten ()
+{
+    SED=$1
+    FILES=$2
+    shift 2
+    for Q in "$@"; do
+	Q2=$(echo "$Q" | sed "$SED")
+	for F in $FILES; do
+	    export total=$((total + 1))
+	    if [ "$(timeout $ZW_TEST_TIMEOUT $DWGREP $F -e "$Q" | sort)" \
+		 != "$($DWGREP $F -e "$Q2" | sort)" ]; then
+		fail "$DWGREP" $F -e "$Q"
+	    fi
+	done
+    done
+}
+
 expect_count 1 -e '1   10 ?lt'
 expect_count 1 -e '10  10 !lt'
 expect_count 1 -e '100 10 !lt'
@@ -232,6 +268,18 @@ expect_count 1 ./nontrivial-types.o -e '
 	entry ?(@AT_language "%s" "DW_LANG_C89" ?match)'
 expect_count 1 ./nontrivial-types.o -e '
 	entry ?(@AT_encoding "%s" "^DW_ATE_signed$" ?match)'
+
+# Test that patterns matched by string comparison behave like those
+# that go through regexec.  The second pattern of each pair is
+# equivalent to the first one, but uses a bracket expression.
+for P in 'ATE_s:AT[E]_s' '^DW_ATE_s:^DW_AT[E]_s' 'signed$:signe[d]$' \
+	 '^DW_ATE_signed$:^DW_ATE_signe[d]$' '.*ATE.*:.*AT[E].*'; do
+    expect_out "$($DWGREP nontrivial-types.o -e "
+		  entry ?(@AT_encoding \"%s\" \"${P#*:}\" ?match)")" \
+	       nontrivial-types.o -e "
+		  entry ?(@AT_encoding \"%s\" \"${P%%:*}\" ?match)"
+done
+
 expect_count 7 ./duplicate-const -e '
 	entry (@AT_decl_file =~ "")'
 expect_count 7 ./duplicate-const -e '
@@ -731,6 +779,19 @@ expect_count 1 ./duplicate-const -e '[entry label] == [entry abbrev label]'
 expect_count 1 ./twocus -e '[abbrev offset] == [0, 0x34]'
 expect_count 1 ./twocus -e '?(abbrev entry (|A| A pos 1 add == A code))'
 
+# The four units of dwz-partial that follow the partial unit share
+# an abbreviation unit.  abbrev yields it once, in order of first use,
+# each time it's asked, and for raw and cooked Dwarf alike.
+expect_count 1 ./dwz-partial -e '
+	[raw unit abbrev offset] == [0, 0x2c, 0x2c, 0x2c, 0x2c]'
+expect_out '0
+0x2c
+0
+0x2c' \
+	   dwz-partial -e '(|D| (1, 2) drop D abbrev offset)'
+expect_count 1 ./dwz-partial -e '
+	(|D| [D raw abbrev offset] == [D abbrev offset])'
+
 # Test that dwgrep doesn't crash on a DIE whose abbrev claims to have
 # children, but that ends up having none.
 expect_count 3 ./haschildren_childless -e 'entry'
@@ -771,6 +832,9 @@ expect_count 1 ./dwz-partial -e '
 expect_count 1 ./dwz-partial -e '
 	[unit root child (offset == 0x14) parent offset] ==
 	[0x34, 0xa4, 0xe1, 0x11e]'
+expect_count 1 ./dwz-partial -e '
+	[unit (pos == 0) root raw child raw child parent offset] ==
+	[unit (pos == 0) root raw child (|C| C raw child C) offset]'
 
 expect_count 4 ./dwz-partial -e '
 	(|A| A entry (offset == 0x14)
@@ -918,6 +982,47 @@ STT_NOTYPE $a@0
 STT_ARM_TFUNC main@0' \
 	 y.o -e 'symbol (name != "") "%s"'
 
+# Test that symbol lookups by name and address yield what filtering
+# all symbols would.
+expect_same_rewritten 's/(\([^()]*==[^()]*\))/?(\1)/g' 'enum.o y.o a1.out' \
+	'symbol (name == "main") pos' \
+	'symbol ("ae" == name) address' \
+	'symbol (address == 4) name' \
+	'symbol (address == 0) (name == "main") pos' \
+	'symbol (name == "no such symbol")'
+
+expect_out 'y.o:
+9
+a1.out:
+68' \
+	   enum.o y.o a1.out -e 'symbol (name == "main") pos'
+
+expect_out 'enum.o:
+af' \
+	   enum.o y.o a1.out -e 'symbol (address == 4) name'
+
+# Machine-readable output formats.
+expect_out '{"stack": [{"type": "str", "value": "ab"}, {"type": "const", "value": 1, "domain": "dec"}]}' \
+	--format=jsonl -e '1 "ab"'
+
+# Bytes that aren't well-formed UTF-8 are replaced, those that are
+# are kept.
+expect_out '{"stack": [{"type": "str", "value": "a\ufffdb\ufffd\ufffdcé"}]}' \
+	--format=jsonl -e '"a\xffb\xc0\xafc\xc3\xa9"'
+
+# The DIE at 0x23 comes from the dwz alternate file of a1.out.
+expect_out '{"stack": [{"type": "die", "offset": 35, "unit": 0, "dwarf": 1, "tag": 38, "tag_name": "const_type"}]}' \
+	--format=jsonl a1.out -e 'entry (offset == 0x23)'
+
+# Test that DIE's from the dwz alternate file are told apart from
+# those of the main file.
+total=$((total + 1))
+OUT=$($DWGREP --format=jsonl dwz-partial2-1 -e 'raw unit root')
+if ! echo "$OUT" | grep -q '"dwarf": 0,' \
+   || ! echo "$OUT" | grep -q '"dwarf": 1,'; then
+    fail "$DWGREP --format=jsonl dwz-partial2-1 -e 'raw unit root'"
+fi
+
 # T_LOCLIST_OP
 
 # Test both T_LOCLIST_ELEM and the corresponding T_LOCLIST_OP output.
@@ -1044,6 +1149,183 @@ expect_out '0
 	   y.o a1.out \
 	   -che 'pos > 1'
 
+# Test that parallel search keeps output in order of files and arguments.
+expect_out \
+'y.o,1:
+["y.o", 1]
+y.o,2:
+["y.o", 2]
+a1.out,1:
+["a1.out", 1]
+a1.out,2:
+["a1.out", 2]
+bitcount.o,1:
+["bitcount.o", 1]
+bitcount.o,2:
+["bitcount.o", 2]' \
+	   -j 2 y.o a1.out bitcount.o \
+	   --a 1,2 -e '[|Dw N| Dw name, N]'
+
+# y.o has no DWARF, the error shouldn't prevent searching the rest.
+expect_out 'a1.out:11
+bitcount.o:14
+dwz-partial2-1:47' \
+	   -s -j 3 -c y.o a1.out bitcount.o dwz-partial2-1 -e 'entry'
+
+# Test that queries split by units yield the same results as serial runs.
+expect_out "$($DWGREP twocus dwz-partial2-1 -e 'entry ?TAG_subprogram name')" \
+	   -j 2 twocus dwz-partial2-1 -e 'entry ?TAG_subprogram name'
+
+expect_out "$($DWGREP dwz-partial -e 'entry (offset == 0x14) parent* ?root')" \
+	   -j 2 dwz-partial -e 'entry (offset == 0x14) parent* ?root'
+
+expect_out "$($DWGREP -c twocus dwz-partial2-1 -e 'entry')" \
+	   -j 3 -c twocus dwz-partial2-1 -e 'entry'
+
+expect_out "$($DWGREP twocus -e 'entry pos')" \
+	   -j 2 twocus -e 'entry pos'
+
+# Test that entry and child skipping DIE's that can't pass the
+# following assertions doesn't change results.  Wrapping an assertion
+# in ?() hides it from the skipping logic.
+expect_same_rewritten 's/\([?!]\)\(TAG\|AT\)_\([a-z_]*\)/?(\1\2_\3)/' \
+	'twocus dwz-partial dwz-partial2-1' \
+	'entry ?TAG_subprogram pos' \
+	'entry !TAG_subprogram ?AT_name (name == "main") pos' \
+	'raw entry ?TAG_partial_unit pos' \
+	'unit entry ?AT_type !AT_name (pos, offset)' \
+	'entry ?root child ?TAG_variable pos' \
+	'entry child ?TAG_imported_unit pos'
+
+expect_out 'foo
+main
+foo' \
+	   twocus -e 'entry ?TAG_subprogram name'
+
+# Test that entry looking up DIE's by offset, and unit and child
+# skipping by offset, don't change results.  Some of the offsets are
+# in the middle of a DIE, or in partial units, or at imported_unit.
+expect_same_rewritten 's/(\([^()]*offset[^()]*\))/?(\1)/g' \
+	'twocus dwz-partial dwz-partial2-1' \
+	'entry (offset == 0x5e)' \
+	'entry (0xb3 == offset) parent' \
+	'entry (offset == 0x5f)' \
+	'entry (offset == 0x100000)' \
+	'entry (offset == 0x14) (|A| A A parent* ?root) "%s inside %s"' \
+	'raw entry (offset == 0x14) parent* ?root' \
+	'entry (offset == 0xf9)' \
+	'raw entry (offset == 0xf9)' \
+	'unit (offset == 0x53) pos' \
+	'unit (offset == 0x53) entry (offset == 0x80)' \
+	'unit (offset == 0x53) entry (offset == 0x14)' \
+	'entry ?root child (offset == 0xb3) pos' \
+	'entry (offset == 0x80) pos'
+
+# The pointer type at 0x14 is in a partial unit that four units
+# import.
+expect_out '[14] pointer_type inside [34] compile_unit
+[14] pointer_type inside [a4] compile_unit
+[14] pointer_type inside [e1] compile_unit
+[14] pointer_type inside [11e] compile_unit' \
+	   dwz-partial -e 'entry (offset == 0x14) (|A| A A parent* ?root)
+			    "%s inside %s"'
+
+# Test that queries answered through DIE index yield the same results
+# as those that walk .debug_info.  The first round builds the index,
+# the second one loads it.
+DWGREP_INDEX_DIR=$(mktemp -d)
+export DWGREP_INDEX_DIR
+for round in build load; do
+    for Q in 'entry ?TAG_subprogram name' \
+	     'raw entry ?TAG_pointer_type pos' \
+	     'entry !TAG_base_type ?AT_name (name == "main") pos' \
+	     'entry ?AT_type !AT_name (pos, offset, parent offset)' \
+	     'entry ?TAG_variable ?AT_location' \
+	     'unit entry ?TAG_typedef ("foo" == name)' \
+	     'entry (offset == 0x14) parent* ?root' \
+	     'raw entry (offset == 0x5e)'; do
+	expect_out "$(DWGREP_INDEX_DIR= $DWGREP twocus dwz-partial \
+			dwz-partial2-1 -e "$Q")" \
+		   twocus dwz-partial dwz-partial2-1 -e "$Q"
+    done
+done
+rm -rf "$DWGREP_INDEX_DIR"
+unset DWGREP_INDEX_DIR
+
+# Test that addrdie yields the same DIE's as filtering entry by
+# address.
+for F in testfile_const_type a1.out twocus aranges.o; do
+    for A in 0 $($DWGREP $F -e 'entry ?TAG_subprogram low'); do
+	expect_out "$($DWGREP $F -e "raw entry ?(address $A ?contains) offset")" \
+		   $F -e "raw $A addrdie offset"
+    done
+done
+
+# Test that --batch runs the query for each line of input.
+BATCH=$(mktemp)
+printf '0x80482f1\n\n0\n' > $BATCH
+expect_out "main" \
+	   testfile_const_type -h --batch $BATCH -e 'addrdie ?TAG_subprogram name'
+expect_out "1
+0" \
+	   testfile_const_type -h -c --batch $BATCH -e 'addrdie ?TAG_subprogram'
+rm -f $BATCH
+
+# Test that --profile doesn't change results, and that it shows how
+# many values each part of the query produced.
+total=$((total + 1))
+Q='entry ?TAG_subprogram name'
+N=$($DWGREP twocus -c -e "$Q")
+if [ "$($DWGREP twocus --profile -e "$Q" 2>/dev/null)" \
+	!= "$($DWGREP twocus -e "$Q")" ] \
+   || ! $DWGREP twocus --profile -e "$Q" 2>&1 >/dev/null \
+	| grep -qE "^ *[0-9]+ +$N +[0-9]+ +[0-9.]+ +[0-9.]+ +\?TAG_subprogram$"; then
+    fail "$DWGREP twocus --profile -e $Q"
+fi
+
+# Test that --explain shows what the query was built into, and that
+# it doesn't need anything to run the query on.
+total=$((total + 1))
+if ! $DWGREP --explain -e 'entry ?(child)' \
+	| grep -qE "^ *[0-9]+ +\?\(\.\.\.\)  =>  pred_subx_any<"; then
+    fail "$DWGREP --explain -e 'entry ?(child)'"
+fi
+
+# Test that with a file to run on, --explain shows overloads that
+# were picked for the types on stack, and that the query yields the
+# same as when the overloads are picked at run time.
+total=$((total + 1))
+if ! $DWGREP twocus --explain -e 'entry name' \
+	| grep -qE "^ *[0-9]+ +name  =>  overload T_DIE$" \
+   || [ "$($DWGREP twocus -e 'entry name')" \
+	!= "$($DWGREP twocus -e 'entry (|D| D name)')" ]; then
+    fail "$DWGREP twocus --explain -e 'entry name'"
+fi
+
+# Test that closures of a single word, which walk depth-first and
+# skip deduplication when they walk a tree, yield the same as those
+# that deduplicate.  The latter yield all children of a DIE before
+# going deeper, so the order differs.
+expect_same_set_rewritten 's/\(child\|parent\)\([*+]\)/(\1 1 drop)\2/' \
+	'twocus dwz-partial dwz-partial2-1' \
+	'raw entry ?root child* offset' \
+	'raw entry ?root child+ offset' \
+	'entry ?root child* offset'
+expect_same_rewritten 's/\(child\|parent\)\([*+]\)/(\1 1 drop)\2/' \
+	'twocus dwz-partial dwz-partial2-1' \
+	'raw entry parent* offset' \
+	'entry parent+ offset'
+
+expect_out '0xb
+0x2d
+0x4b
+0x5e
+0x80
+0xa3
+0xb0
+0xb3' \
+	   twocus -e 'entry ?root child* offset'
+
 # =============================================================================
 
 echo "$total tests total, $failures failures."